@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Native threads repeatedly attach to and detach from the VM through
+   the JNI invocation interface, as a JNI caller creating a thread per
+   request would.
+
+   Usage: AttachDetach [<threads> [<attaches per thread> [<rounds>]]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "jni.h"
+
+/* Not declared in JamVM's jni.h */
+extern jint JNI_CreateJavaVM(JavaVM **pvm, void **penv, void *args);
+
+static JavaVM *vm;
+static int attaches = 100000;
+
+static void *attachLoop(void *arg) {
+    JNIEnv *env;
+    int i;
+
+    for(i = 0; i < attaches; i++) {
+        if((*vm)->AttachCurrentThread(vm, (void**)&env, NULL) != JNI_OK) {
+            fprintf(stderr, "AttachCurrentThread failed\n");
+            exit(1);
+        }
+
+        (*vm)->DetachCurrentThread(vm);
+    }
+
+    return NULL;
+}
+
+static long long now() {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int rounds = argc > 3 ? atoi(argv[3]) : 5;
+    pthread_t tids[threads];
+    JavaVMInitArgs args;
+    JNIEnv *env;
+    int round, i;
+
+    if(argc > 2)
+        attaches = atoi(argv[2]);
+
+    args.version = JNI_VERSION_1_4;
+    args.nOptions = 0;
+    args.options = NULL;
+    args.ignoreUnrecognized = JNI_FALSE;
+
+    if(JNI_CreateJavaVM(&vm, (void**)&env, &args) != JNI_OK) {
+        fprintf(stderr, "Couldn't create the VM\n");
+        return 1;
+    }
+
+    for(round = 1; round <= rounds; round++) {
+        long long start = now();
+        long long micros;
+
+        for(i = 0; i < threads; i++)
+            pthread_create(&tids[i], NULL, attachLoop, NULL);
+
+        for(i = 0; i < threads; i++)
+            pthread_join(tids[i], NULL);
+
+        micros = now() - start;
+
+        printf("round %d: %d threads, %d attach/detach each in %lld ms "
+               "(%.2f us per attach/detach)\n", round, threads, attaches,
+               micros / 1000, (double)micros / ((double)threads * attaches));
+    }
+
+    return 0;
+}
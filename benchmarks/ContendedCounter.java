@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* N threads increment one counter inside a synchronized block.  With
+   more than one thread the lock is contended, and threads continually
+   inflate it and wait for it to be released.
+
+   Usage: ContendedCounter [<threads> [<increments per thread> [<rounds>]]] */
+
+public class ContendedCounter {
+    private static final Object lock = new Object();
+    private static long count;
+
+    public static void main(String[] args) throws InterruptedException {
+        int threads = args.length > 0 ? Integer.parseInt(args[0]) : 4;
+        final int increments = args.length > 1 ? Integer.parseInt(args[1]) : 1000000;
+        int rounds = args.length > 2 ? Integer.parseInt(args[2]) : 5;
+
+        for(int round = 1; round <= rounds; round++) {
+            Thread[] workers = new Thread[threads];
+
+            count = 0;
+            for(int i = 0; i < threads; i++)
+                workers[i] = new Thread() {
+                    public void run() {
+                        for(int j = 0; j < increments; j++)
+                            synchronized(lock) {
+                                count++;
+                            }
+                    }
+                };
+
+            long start = System.nanoTime();
+
+            for(int i = 0; i < threads; i++)
+                workers[i].start();
+            for(int i = 0; i < threads; i++)
+                workers[i].join();
+
+            long millis = (System.nanoTime() - start) / 1000000;
+
+            if(count != (long)threads * increments)
+                throw new RuntimeException("Lost increments: " + count);
+
+            System.out.println("round " + round + ": " + threads + " threads, " +
+                               count + " increments in " + millis + " ms (" +
+                               count / Math.max(millis, 1) + " per ms)");
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Throws an exception from a given stack depth and catches it at the
+   top, measuring exception dispatch.  Each depth is run twice: once
+   throwing a preallocated exception (the cost of finding the handler
+   and unwinding), and once creating a new exception each time (which
+   also fills in the stack trace).  The frames between the throw and
+   the catch each have a handler for an unrelated exception, so the
+   handler search checks and rejects an entry in every frame.
+
+   Usage: ExceptionDispatch [<throws per depth> [<depth> ...]] */
+
+public class ExceptionDispatch {
+    private static final RuntimeException preallocated =
+            new IllegalStateException();
+
+    private static int caught;
+
+    static int recurse(int depth, boolean allocate) {
+        if(depth == 0) {
+            if(allocate)
+                throw new IllegalStateException();
+            throw preallocated;
+        }
+
+        try {
+            return recurse(depth - 1, allocate) + 1;
+        } catch(IllegalArgumentException e) {
+            return -1;
+        }
+    }
+
+    static long run(int depth, int throws, boolean allocate) {
+        long start = System.nanoTime();
+
+        for(int i = 0; i < throws; i++)
+            try {
+                recurse(depth, allocate);
+            } catch(IllegalStateException e) {
+                caught++;
+            }
+
+        return System.nanoTime() - start;
+    }
+
+    public static void main(String[] args) {
+        int throws = args.length > 0 ? Integer.parseInt(args[0]) : 100000;
+        int[] depths = {0, 1, 4, 16, 64};
+
+        if(args.length > 1) {
+            depths = new int[args.length - 1];
+            for(int i = 1; i < args.length; i++)
+                depths[i - 1] = Integer.parseInt(args[i]);
+        }
+
+        /* Warm up, so the code is prepared (and inlined) */
+        for(int i = 0; i < depths.length; i++) {
+            run(depths[i], throws / 10, false);
+            run(depths[i], throws / 10, true);
+        }
+
+        for(int i = 0; i < depths.length; i++) {
+            long preallocNanos = run(depths[i], throws, false);
+            long allocNanos = run(depths[i], throws, true);
+
+            System.out.println("depth " + depths[i] + ": " +
+                               preallocNanos / throws + " ns per throw (" +
+                               allocNanos / throws + " ns with a new exception)");
+        }
+
+        if(caught != throws * depths.length * 2 + throws / 10 * depths.length * 2)
+            throw new RuntimeException("Missed exceptions: " + caught);
+    }
+}
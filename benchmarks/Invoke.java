@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Measures method invocation: recursive static calls (fib), virtual
+   calls and interface calls.  The virtual and interface calls are
+   made from one call site to a receiver of a single class, and then
+   to receivers of four classes in turn, so both the monomorphic and
+   polymorphic paths (including the interface cache) are timed.  The
+   called methods do a little arithmetic, so they are not treated as
+   trivial getters and setters.
+
+   Usage: Invoke [<calls> [<fib argument>]] */
+
+public class Invoke {
+    interface Op {
+        int apply(int x);
+    }
+
+    static abstract class Base implements Op {
+        abstract int call(int x);
+    }
+
+    static class Add extends Base {
+        int call(int x) { return x + 1; }
+        public int apply(int x) { return x + 1; }
+    }
+
+    static class Sub extends Base {
+        int call(int x) { return x - 1; }
+        public int apply(int x) { return x - 1; }
+    }
+
+    static class Xor extends Base {
+        int call(int x) { return x ^ 1; }
+        public int apply(int x) { return x ^ 1; }
+    }
+
+    static class Neg extends Base {
+        int call(int x) { return -x; }
+        public int apply(int x) { return -x; }
+    }
+
+    static int fib(int n) {
+        return n < 2 ? n : fib(n - 1) + fib(n - 2);
+    }
+
+    /* Number of calls made by fib(n) */
+    static long fibCalls(int n) {
+        long a = 1, b = 1;
+
+        for(int i = 1; i < n; i++) {
+            long c = a + b + 1;
+            a = b;
+            b = c;
+        }
+
+        return b;
+    }
+
+    static int sink;
+
+    static long virtualCalls(Base[] receivers, int calls) {
+        long start = System.nanoTime();
+        int x = 0;
+
+        for(int i = 0; i < calls; i++)
+            x = receivers[i & 3].call(x);
+
+        sink += x;
+        return System.nanoTime() - start;
+    }
+
+    static long interfaceCalls(Op[] receivers, int calls) {
+        long start = System.nanoTime();
+        int x = 0;
+
+        for(int i = 0; i < calls; i++)
+            x = receivers[i & 3].apply(x);
+
+        sink += x;
+        return System.nanoTime() - start;
+    }
+
+    static long fibTime(int n) {
+        long start = System.nanoTime();
+
+        sink += fib(n);
+        return System.nanoTime() - start;
+    }
+
+    static void report(String name, long nanos, long calls) {
+        System.out.println(name + ": " + (nanos * 1000 / calls) / 1000.0 +
+                           " ns per call");
+    }
+
+    public static void main(String[] args) {
+        int calls = args.length > 0 ? Integer.parseInt(args[0]) : 10000000;
+        int n = args.length > 1 ? Integer.parseInt(args[1]) : 27;
+
+        Base add = new Add();
+        Base[] mono = {add, add, add, add};
+        Base[] poly = {add, new Sub(), new Xor(), new Neg()};
+
+        /* Warm up, so the code is prepared (and inlined) */
+        fibTime(n / 2);
+        virtualCalls(mono, calls / 10);
+        virtualCalls(poly, calls / 10);
+        interfaceCalls(mono, calls / 10);
+        interfaceCalls(poly, calls / 10);
+
+        report("fib(" + n + ")", fibTime(n), fibCalls(n));
+        report("virtual, monomorphic", virtualCalls(mono, calls), calls);
+        report("virtual, polymorphic", virtualCalls(poly, calls), calls);
+        report("interface, monomorphic", interfaceCalls(mono, calls), calls);
+        report("interface, polymorphic", interfaceCalls(poly, calls), calls);
+    }
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+import java.io.ByteArrayOutputStream;
+import java.io.InputStream;
+
+/* Measures start-up of many threads which each run code for the first
+   time.  Every thread defines its own copy of the Work class in a new
+   class loader, so the threads load, link and prepare disjoint methods
+   concurrently.  The same work is then done on a single thread, one
+   copy after another, for comparison (the parallel time also includes
+   starting the threads, which ThreadStart measures on its own).
+
+   Usage: ParallelStartup [<threads> [<rounds>]] */
+
+public class ParallelStartup {
+    public static class Work implements Runnable {
+        static int sink;
+
+        int m0(int x) {
+            for(int i = 0; i < 4; i++)
+                x = m1(x + i);
+            return x;
+        }
+
+        int m1(int x) {
+            switch(x & 3) {
+                case 0: return m2(x) + 1;
+                case 1: return m2(x) - 1;
+                case 2: return m2(x) ^ 2;
+                default: return m2(x);
+            }
+        }
+
+        int m2(int x) {
+            int y = x;
+            while(y > 100)
+                y >>= 1;
+            return m3(y) + x;
+        }
+
+        int m3(int x) {
+            return x < 0 ? m4(-x) : m4(x * 3);
+        }
+
+        int m4(int x) {
+            int[] a = {x, x + 1, x + 2, x + 3};
+            int sum = 0;
+            for(int i = 0; i < a.length; i++)
+                sum += a[i];
+            return m5(sum);
+        }
+
+        int m5(int x) {
+            long l = x;
+            l = l * 31 + 17;
+            return m6((int)(l >>> 3));
+        }
+
+        int m6(int x) {
+            StringBuilder b = new StringBuilder();
+            b.append(x & 7);
+            return m7(x + b.length());
+        }
+
+        int m7(int x) {
+            if((x & 1) == 0)
+                return m8(x / 2);
+            return m8(x * 3 + 1);
+        }
+
+        int m8(int x) {
+            double d = x;
+            return m9((int)(d * 1.5));
+        }
+
+        int m9(int x) {
+            try {
+                return m10(100 / (x | 1));
+            } catch(ArithmeticException e) {
+                return 0;
+            }
+        }
+
+        int m10(int x) {
+            Object o = x > 10 ? (Object)"big" : (Object)Integer.valueOf(x);
+            return m11(o instanceof String ? x : x + 1);
+        }
+
+        int m11(int x) {
+            char[] c = new char[8];
+            for(int i = 0; i < c.length; i++)
+                c[i] = (char)('a' + ((x + i) & 15));
+            return m12(new String(c).hashCode());
+        }
+
+        int m12(int x) {
+            int r = 0;
+            for(int i = 0; i < 32; i++)
+                if((x & (1 << i)) != 0)
+                    r++;
+            return m13(r);
+        }
+
+        int m13(int x) {
+            return m14(Math.max(x, 3) + Math.min(x, 5));
+        }
+
+        int m14(int x) {
+            short s = (short)x;
+            byte b = (byte)(x >> 2);
+            return m15(s + b);
+        }
+
+        int m15(int x) {
+            return x + (x << 2);
+        }
+
+        public void run() {
+            sink += m0(1);
+        }
+    }
+
+    static class Loader extends ClassLoader {
+        private final byte[] bytes;
+
+        Loader(byte[] bytes) {
+            super(ParallelStartup.class.getClassLoader());
+            this.bytes = bytes;
+        }
+
+        protected synchronized Class<?> loadClass(String name, boolean resolve)
+                throws ClassNotFoundException {
+
+            if(!name.equals(Work.class.getName()))
+                return super.loadClass(name, resolve);
+
+            Class<?> c = findLoadedClass(name);
+
+            if(c == null)
+                c = defineClass(name, bytes, 0, bytes.length);
+
+            return c;
+        }
+    }
+
+    static byte[] workBytes() throws Exception {
+        String name = Work.class.getName().replace('.', '/') + ".class";
+        InputStream in = ParallelStartup.class.getClassLoader()
+                                              .getResourceAsStream(name);
+        ByteArrayOutputStream out = new ByteArrayOutputStream();
+        byte[] buff = new byte[4096];
+        int n;
+
+        while((n = in.read(buff)) > 0)
+            out.write(buff, 0, n);
+
+        in.close();
+        return out.toByteArray();
+    }
+
+    static void runCopy(byte[] bytes) {
+        try {
+            Class<?> c = new Loader(bytes).loadClass(Work.class.getName());
+            ((Runnable)c.newInstance()).run();
+        } catch(Exception e) {
+            throw new RuntimeException(e);
+        }
+    }
+
+    static long parallel(final byte[] bytes, int threads)
+            throws InterruptedException {
+
+        Thread[] workers = new Thread[threads];
+        long start = System.nanoTime();
+
+        for(int i = 0; i < threads; i++) {
+            workers[i] = new Thread() {
+                public void run() {
+                    runCopy(bytes);
+                }
+            };
+            workers[i].start();
+        }
+
+        for(int i = 0; i < threads; i++)
+            workers[i].join();
+
+        return System.nanoTime() - start;
+    }
+
+    static long serial(byte[] bytes, int copies) {
+        long start = System.nanoTime();
+
+        for(int i = 0; i < copies; i++)
+            runCopy(bytes);
+
+        return System.nanoTime() - start;
+    }
+
+    public static void main(String[] args) throws Exception {
+        int threads = args.length > 0 ? Integer.parseInt(args[0]) : 64;
+        int rounds = args.length > 1 ? Integer.parseInt(args[1]) : 5;
+        byte[] bytes = workBytes();
+
+        for(int round = 1; round <= rounds; round++) {
+            long parallelMicros = parallel(bytes, threads) / 1000;
+            long serialMicros = serial(bytes, threads) / 1000;
+
+            System.out.println("round " + round + ": " + threads +
+                               " threads in " + parallelMicros / 1000 +
+                               " ms (" + serialMicros / 1000 +
+                               " ms on one thread)");
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#!/bin/sh
+##
+## Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+##
+## This file is part of JamVM.
+##
+## This program is free software; you can redistribute it and/or
+## modify it under the terms of the GNU General Public License
+## as published by the Free Software Foundation; either version 2,
+## or (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program; if not, write to the Free Software
+## Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+##
+
+# Measures start-up from the command line with and without the
+# prepared-code cache (-Xprepcache).  A short benchmark is run
+# repeatedly without the cache, and then with a cache file filled by
+# an initial run, printing the average time of a run for each.
+#
+# Usage: run.sh PrepCacheStartup [<runs> [<benchmark> [<arguments>]]]
+#
+# The default is 20 runs of "ThreadStart 1 1 1", which starts the VM
+# and a single thread.
+
+dir=`dirname $0`
+
+runs=${1:-20}
+test $# -gt 0 && shift
+
+bench=${1:-ThreadStart}
+test $# -gt 0 && shift
+
+if test $# -eq 0 -a $bench = ThreadStart; then
+    set -- 1 1 1
+fi
+
+cache=${TMPDIR:-/tmp}/prepcache.$$
+rm -f $cache
+
+# Print the average time in ms of $runs runs with the given VM options
+timeRuns() {
+    opts=$1
+    shift
+
+    start=`date +%s%N`
+    i=0
+
+    while test $i -lt $runs; do
+        JAVA_OPTS="$JAVA_OPTS $opts" $dir/run.sh $bench "$@" > /dev/null || exit 1
+        i=`expr $i + 1`
+    done
+
+    end=`date +%s%N`
+    echo `expr \( $end - $start \) / $runs / 1000000`
+}
+
+# Compile the benchmark and fill the cache, outside the timed runs
+JAVA_OPTS="$JAVA_OPTS -Xprepcache:$cache" $dir/run.sh $bench "$@" \
+    > /dev/null || exit 1
+
+uncached=`timeRuns "" "$@"`
+cached=`timeRuns "-Xprepcache:$cache" "$@"`
+
+rm -f $cache
+
+echo "$bench: $uncached ms per run without the prepared-code cache," \
+     "$cached ms with it ($runs runs)"
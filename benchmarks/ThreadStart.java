@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Starts and joins threads which do no work, measuring the cost of
+   creating a thread.  Each round starts the threads in batches of
+   <concurrent>, so the start path is also run concurrently.
+
+   Usage: ThreadStart [<threads per round> [<concurrent> [<rounds>]]] */
+
+public class ThreadStart {
+    public static void main(String[] args) throws InterruptedException {
+        int threads = args.length > 0 ? Integer.parseInt(args[0]) : 10000;
+        int concurrent = args.length > 1 ? Integer.parseInt(args[1]) : 1;
+        int rounds = args.length > 2 ? Integer.parseInt(args[2]) : 5;
+
+        for(int round = 1; round <= rounds; round++) {
+            Thread[] batch = new Thread[concurrent];
+            long start = System.nanoTime();
+
+            for(int i = 0; i < threads; i += concurrent) {
+                for(int j = 0; j < concurrent; j++) {
+                    batch[j] = new Thread();
+                    batch[j].start();
+                }
+
+                for(int j = 0; j < concurrent; j++)
+                    batch[j].join();
+            }
+
+            long micros = (System.nanoTime() - start) / 1000;
+
+            System.out.println("round " + round + ": " + threads + " threads (" +
+                               concurrent + " at a time) in " + micros / 1000 +
+                               " ms (" + micros / threads + " us per thread)");
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#!/bin/sh
+##
+## Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+##
+## This file is part of JamVM.
+##
+## This program is free software; you can redistribute it and/or
+## modify it under the terms of the GNU General Public License
+## as published by the Free Software Foundation; either version 2,
+## or (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program; if not, write to the Free Software
+## Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+##
+
+# Run one of the microbenchmarks in this directory.
+#
+# Usage: run.sh <benchmark> [<benchmark arguments>]
+#
+# The benchmarks are compiled with $JAVAC (default javac, with the
+# options in $JAVAC_OPTS) into $CLASSES (default ./classes) and run
+# with $JAVA (default jamvm), with any options in $JAVA_OPTS.  To
+# compare two VMs, run the benchmark once with each, e.g.
+#
+#   JAVA=/usr/local/jamvm/bin/jamvm ./run.sh ContendedCounter 8
+#   JAVA=src/jamvm ./run.sh ContendedCounter 8
+#
+# Benchmarks written in C use the JNI invocation interface.  They are
+# compiled with $CC against the JamVM installed in $JAMVM_PREFIX
+# (default /usr/local/jamvm) into $CLASSES, and run with its libjvm.
+#
+# Benchmarks written as shell scripts time whole runs of $JAVA (e.g.
+# start-up), and are run with the same settings.
+
+dir=`dirname $0`
+
+: ${JAVAC:=javac}
+: ${JAVAC_OPTS:="-source 1.8 -target 1.8"}
+: ${JAVA:=jamvm}
+: ${CLASSES:=$dir/classes}
+: ${CC:=cc}
+: ${JAMVM_PREFIX:=/usr/local/jamvm}
+
+if test $# -lt 1; then
+    echo "Usage: $0 <benchmark> [<benchmark arguments>]" >&2
+    exit 1
+fi
+
+bench=$1
+shift
+
+mkdir -p $CLASSES
+
+if test -f $dir/$bench.sh; then
+    export JAVAC JAVAC_OPTS JAVA CLASSES
+    exec sh $dir/$bench.sh "$@"
+fi
+
+if test -f $dir/$bench.c; then
+    if test ! -f $CLASSES/$bench -o $dir/$bench.c -nt $CLASSES/$bench; then
+        $CC -O2 -I$JAMVM_PREFIX/include -o $CLASSES/$bench $dir/$bench.c \
+            -L$JAMVM_PREFIX/lib -ljvm -lpthread || exit 1
+    fi
+
+    LD_LIBRARY_PATH=$JAMVM_PREFIX/lib${LD_LIBRARY_PATH:+:$LD_LIBRARY_PATH} \
+        exec $CLASSES/$bench "$@"
+fi
+
+if test ! -f $dir/$bench.java; then
+    echo "$0: unknown benchmark $bench" >&2
+    exit 1
+fi
+
+if test ! -f $CLASSES/$bench.class -o $dir/$bench.java -nt $CLASSES/$bench.class; then
+    $JAVAC $JAVAC_OPTS -d $CLASSES $dir/$bench.java || exit 1
+fi
+
+exec $JAVA $JAVA_OPTS -cp $CLASSES $bench "$@"
@@ -727,6 +727,9 @@ static void doMark(Thread *self, int mark_soft_refs) {
     markBootClasses();
     markJNIGlobalRefs();
     scanThreads();
+#ifdef INLINING
+    markInliningQueue();
+#endif
 
     /* All roots should now be marked.  Scan the heap and recursively
        mark all marked objects - once the heap has been scanned all
@@ -873,6 +876,12 @@ static uintptr_t doSweep(Thread *self) {
     /* Amount of free heap is re-calculated during scan */
     heapfree = 0;
 
+#ifdef DIRECT
+    /* Remove classes which are about to be unloaded
+       from the interpreter's inline caches */
+    scanInterfaceCaches();
+#endif
+
     /* Scan the heap and free all unmarked objects by reconstructing
        the freelist.  Add all free chunks and unmarked objects and
        merge adjacent free chunks into contiguous areas */
@@ -1189,6 +1198,14 @@ static void threadClassData(Class *class, Class *new_addr) {
     for(i = 0; i < cb->imethod_table_size; i++)
         THREAD_REFERENCE(&cb->imethod_table[i].interface);
 
+    for(i = 0; i < PRIMARY_SUPERS_DEPTH; i++)
+        THREAD_CLASSBLOCK_FIELD(cb, primary_supers[i]);
+
+    for(i = 0; i < cb->secondary_supers_count; i++)
+        THREAD_REFERENCE(&cb->secondary_supers[i]);
+
+    THREAD_CLASSBLOCK_FIELD(cb, secondary_super_cache);
+
     TRACE_COMPACT("Threading static fields for class %s\n", cb->name);
 
     /* If the class has not been linked it's
@@ -1384,6 +1401,9 @@ uintptr_t doCompact() {
     /* Thread object references from outside of the heap */
     threadBootClasses();
     threadMonitorCache();
+#ifdef DIRECT
+    threadInterfaceCaches();
+#endif
     threadInternedStrings();
     threadLiveClassLoaderDlls();
 
@@ -1541,6 +1561,10 @@ marked_phase2:
 
     /* Free conservative roots hash table */
     gcMemFree(con_roots_hashtable);
+
+    /* Objects may have moved - monitor cache entries are
+       hashed on object address */
+    rehashMonitorCache();
     
     /* Class library specific post compact processing - this
        is currently limited to the JSR 292 intrinsic cache
@@ -1636,6 +1660,10 @@ unsigned long gc0(int mark_soft_refs, int compact) {
     if(compact_override)
         compact = compact_value;
 
+    /* Profile samples must be symbolized before their
+       methods' classes can be unloaded */
+    drainCPUProfile();
+
     /* Reset flags.  Will be set during GC if a thread needs
        to be woken up */
     notify_finaliser_thread = notify_reference_thread = FALSE;
@@ -1678,6 +1706,14 @@ unsigned long gc0(int mark_soft_refs, int compact) {
         largest = compact ? doCompact() : doSweep(self);
     }
 
+    /* Classes may have moved or been unloaded */
+    flushCatchCaches();
+
+#ifdef INLINING
+    /* Evict cold inlined code while the world is stopped */
+    sweepCodeMemory();
+#endif
+
     /* Restart the world */
     resumeAllThreads(self);
     enableSuspend(self);
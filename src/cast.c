@@ -36,7 +36,51 @@ char implements(Class *class, Class *test) {
     return FALSE;
 }
 
+/* Search the secondary supers of a linked class, remembering
+   the last hit.  The cache is updated without locking, as any
+   value written is a valid secondary super */
+
+static char isSecondarySuper(Class *class, ClassBlock *test_cb) {
+    int i;
+
+    if(test_cb->secondary_super_cache == class)
+        return TRUE;
+
+    for(i = 0; i < test_cb->secondary_supers_count; i++)
+        if(test_cb->secondary_supers[i] == class) {
+            test_cb->secondary_super_cache = class;
+            return TRUE;
+        }
+
+    return FALSE;
+}
+
+/* Subclass test using the supers display of the linked classes
+   (see linkClass).  A linked class's superclasses are all linked,
+   so an unlinked class cannot be a superclass */
+
+static char isLinkedSubClassOf(Class *class, ClassBlock *test_cb) {
+    ClassBlock *class_cb = CLASS_CB(class);
+    int depth = class_cb->super_depth;
+
+    if(!IS_LINKED(class_cb))
+        return FALSE;
+
+    if(depth < PRIMARY_SUPERS_DEPTH)
+        return test_cb->primary_supers[depth] == class;
+
+    return isSecondarySuper(class, test_cb);
+}
+
 char isSubClassOf(Class *class, Class *test) {
+    ClassBlock *test_cb = CLASS_CB(test);
+
+    if(class == test)
+        return TRUE;
+
+    if(IS_LINKED(test_cb) && !IS_INTERFACE(CLASS_CB(class)))
+        return isLinkedSubClassOf(class, test_cb);
+
     for(; test != NULL && test != class; test = CLASS_CB(test)->super);
     return test != NULL;
 }
@@ -66,9 +110,20 @@ char isInstOfArray(Class *class, Class *test) {
 }
 
 char isInstanceOf(Class *class, Class *test) {
+    ClassBlock *test_cb = CLASS_CB(test);
+
     if(class == test)
         return TRUE;
 
+    /* Array classes and primitive classes are not linked, and
+       use the checks below */
+    if(IS_LINKED(test_cb) && !IS_ARRAY(CLASS_CB(class))) {
+        if(IS_INTERFACE(CLASS_CB(class)))
+            return isSecondarySuper(class, test_cb);
+
+        return isLinkedSubClassOf(class, test_cb);
+    }
+
     if(IS_INTERFACE(CLASS_CB(class)))
         return implements(class, test);
     else
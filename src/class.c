@@ -97,6 +97,9 @@ static char abstract_method[] = {OPC_ABSTRACT_METHOD_ERROR};
    the unimplemented interface method that it represents. */
 static char miranda_bridge[] = {OPC_MIRANDA_BRIDGE};
 
+/* Last ID given to an interface */
+static int interface_id_count = 0;
+
 static Class *addClassToHash(Class *class, Object *class_loader) {
     HashTable *table;
     Class *entry;
@@ -356,6 +359,13 @@ Class *parseClass(char *classname, char *data, int offset, int len,
 
     READ_U2(classblock->access_flags, ptr, len);
 
+    /* Interfaces are given an ID which is used to index the imethod
+       table hash of implementing classes (see hashIMethodTable).
+       Classes are parsed concurrently, but a duplicate ID only leads
+       to a collision in the hash */
+    if(classblock->access_flags & ACC_INTERFACE)
+        classblock->interface_id = ++interface_id_count;
+
     READ_TYPE_INDEX(this_idx, constant_pool, CONSTANT_Class, ptr, len);
     classblock->name = CP_UTF8(constant_pool,
                                CP_CLASS(constant_pool, this_idx));
@@ -737,7 +747,14 @@ Class *defineClass(char *classname, char *data, int offset, int len,
     Class *class = parseClass(classname, data, offset, len, class_loader);
 
     if(class != NULL) {
-        Class *found = addClassToHash(class, class_loader);
+        Class *found;
+
+#ifdef PREPARE_CACHE
+        /* Identifies the class's methods in the prepared-code cache */
+        CLASS_CB(class)->file_hash = prepareCacheHash(data + offset, len);
+#endif
+
+        found = addClassToHash(class, class_loader);
 
         if(found != class) {
             CLASS_CB(class)->flags = CLASS_CLASH;
@@ -1045,6 +1062,219 @@ typedef struct miranda {
     int default_conflict;
 } Miranda;
 
+/* The imethod table hash maps an interface to the index of its entry
+   in the imethod table, giving constant-time interface dispatch.  It
+   is keyed on the interface's ID rather than its address, as classes
+   are moved by heap compaction.  Entries hold the index plus one (zero
+   is an empty slot) */
+
+static void hashIMethodTable(ClassBlock *cb) {
+    int size, mask, i;
+
+    if(cb->imethod_table_size == 0)
+        return;
+
+    for(size = 4; size < cb->imethod_table_size * 2; size <<= 1);
+
+    mask = size - 1;
+    cb->imethod_hash = sysMalloc(size * sizeof(int));
+    memset(cb->imethod_hash, 0, size * sizeof(int));
+
+    for(i = 0; i < cb->imethod_table_size; i++) {
+        Class *interface = cb->imethod_table[i].interface;
+        int j = CLASS_CB(interface)->interface_id & mask;
+        int idx;
+
+        /* An interface may appear more than once in the table.
+           Any of the entries can be used */
+        for(; (idx = cb->imethod_hash[j]) != 0; j = (j + 1) & mask)
+            if(cb->imethod_table[idx - 1].interface == interface)
+                break;
+
+        if(idx == 0)
+            cb->imethod_hash[j] = i + 1;
+    }
+
+    cb->imethod_hash_size = size;
+}
+
+/* Recognise trivial methods from their bytecode: empty methods,
+   methods returning a constant, field getters and setters on this
+   and constructors which only call an empty super constructor.
+   The interpreter performs calls to these inline.  Field and method
+   references are not resolved until a call site is quickened */
+
+static void findTrivialMethod(MethodBlock *mb) {
+    unsigned char *code = mb->code;
+    int len = mb->code_size;
+    int value, value_len;
+
+    if(code == NULL || mb->access_flags & (ACC_ABSTRACT | ACC_NATIVE |
+                                           ACC_SYNCHRONIZED))
+        return;
+
+    if(len == 1 && code[0] == OPC_RETURN) {
+        mb->trivial = TRIVIAL_EMPTY;
+        return;
+    }
+
+    if(code[0] == OPC_ALOAD_0) {
+        if(mb->access_flags & ACC_STATIC)
+            return;
+
+        /* aload_0; getfield; <x>return */
+        if(len == 5 && code[1] == OPC_GETFIELD && code[4] >= OPC_IRETURN
+                                               && code[4] <= OPC_ARETURN) {
+            mb->trivial = TRIVIAL_GETTER;
+            mb->trivial_index = (code[2] << 8) | code[3];
+
+        /* aload_0; <x>load_1; putfield; return */
+        } else if(len == 6 && code[1] >= OPC_ILOAD_1 && code[1] <= OPC_ALOAD_1
+                      && (code[1] - OPC_ILOAD_1) % 4 == 0
+                      && code[2] == OPC_PUTFIELD && code[5] == OPC_RETURN) {
+            mb->trivial = TRIVIAL_SETTER;
+            mb->trivial_index = (code[3] << 8) | code[4];
+
+        /* aload_0; invokespecial <init>; return */
+        } else if(len == 5 && code[1] == OPC_INVOKESPECIAL
+                           && code[4] == OPC_RETURN
+                           && mb->name == SYMBOL(object_init)) {
+            mb->trivial = TRIVIAL_INIT;
+            mb->trivial_index = (code[2] << 8) | code[3];
+        }
+        return;
+    }
+
+    switch(code[0]) {
+        case OPC_ACONST_NULL:
+            value = 0;
+            value_len = 1;
+            break;
+
+        case OPC_ICONST_M1: case OPC_ICONST_0: case OPC_ICONST_1:
+        case OPC_ICONST_2: case OPC_ICONST_3: case OPC_ICONST_4:
+        case OPC_ICONST_5:
+            value = code[0] - OPC_ICONST_0;
+            value_len = 1;
+            break;
+
+        case OPC_FCONST_0:
+            value = 0;
+            value_len = 1;
+            break;
+
+        case OPC_FCONST_1:
+            value = 0x3f800000;
+            value_len = 1;
+            break;
+
+        case OPC_FCONST_2:
+            value = 0x40000000;
+            value_len = 1;
+            break;
+
+        case OPC_BIPUSH:
+            value = (signed char)code[1];
+            value_len = 2;
+            break;
+
+        case OPC_SIPUSH:
+            value = (signed short)((code[1] << 8) | code[2]);
+            value_len = 3;
+            break;
+
+        default:
+            return;
+    }
+
+    /* <x>const/bipush/sipush; ireturn, freturn or areturn */
+    if(len == value_len + 1 && (code[value_len] == OPC_IRETURN ||
+                                code[value_len] == OPC_FRETURN ||
+                                code[value_len] == OPC_ARETURN)) {
+        mb->trivial = TRIVIAL_CONSTANT;
+        mb->trivial_operand = value;
+    }
+}
+
+/* Fill in the primary supers display and the secondary supers
+   (see jam.h).  Interfaces have Object as their only primary super.
+   The secondary supers are the interfaces in the imethod table,
+   which include inherited and super-interfaces, plus superclasses
+   too deep for the display */
+
+static void setupSupers(Class *class) {
+    ClassBlock *cb = CLASS_CB(class);
+    Class *super = cb->super;
+    Class **secondary;
+    int depth = 0;
+    int count = 0;
+    int i, j;
+    Thread *self;
+
+    if(!IS_INTERFACE(cb))
+        for(; super != NULL; super = CLASS_CB(super)->super, depth++);
+
+    secondary = sysMalloc((cb->imethod_table_size + (depth >
+                     PRIMARY_SUPERS_DEPTH ? depth - PRIMARY_SUPERS_DEPTH : 0))
+                     * sizeof(Class*));
+
+    /* The class references are updated by the GC during heap
+       compaction - disable suspension while they are copied */
+    self = threadSelf();
+    fastDisableSuspend(self);
+
+    if(IS_INTERFACE(cb))
+        cb->primary_supers[0] = cb->super;
+    else {
+        Class *spr = class;
+
+        for(i = depth; i >= 0; i--, spr = CLASS_CB(spr)->super)
+            if(i < PRIMARY_SUPERS_DEPTH)
+                cb->primary_supers[i] = spr;
+            else if(spr != class)
+                secondary[count++] = spr;
+    }
+
+    for(i = 0; i < cb->imethod_table_size; i++) {
+        Class *interface = cb->imethod_table[i].interface;
+
+        for(j = 0; j < count && secondary[j] != interface; j++);
+
+        if(j == count)
+            secondary[count++] = interface;
+    }
+
+    cb->super_depth = depth;
+    cb->secondary_supers = secondary;
+    cb->secondary_supers_count = count;
+
+    fastEnableSuspend(self);
+}
+
+/* Returns the index of the interface in the class's imethod
+   table, or -1 if the class does not implement the interface */
+
+int findIMethodTableIndex(ClassBlock *cb, Class *interface) {
+    int idx;
+
+    if(cb->imethod_hash != NULL) {
+        int mask = cb->imethod_hash_size - 1;
+        int i = CLASS_CB(interface)->interface_id & mask;
+
+        for(; (idx = cb->imethod_hash[i]) != 0; i = (i + 1) & mask)
+            if(cb->imethod_table[idx - 1].interface == interface)
+                return idx - 1;
+
+        return -1;
+    }
+
+    for(idx = 0; idx < cb->imethod_table_size; idx++)
+        if(cb->imethod_table[idx].interface == interface)
+            return idx;
+
+    return -1;
+}
+
 void linkClass(Class *class) {
    static MethodBlock *obj_fnlzr_mthd = NULL;
 
@@ -1129,6 +1359,23 @@ void linkClass(Class *class) {
            mb->max_stack = 0;
        }
 
+       /* Synchronized methods are always entered generically.  With
+          the direct interpreter, other interpreted methods are entered
+          generically until they have been prepared */
+       if(!(mb->access_flags & ACC_SYNCHRONIZED)) {
+           if(mb->access_flags & ACC_NATIVE)
+               mb->entry = ENTRY_NATIVE;
+#ifndef DIRECT
+           else
+               mb->entry = ENTRY_INTERPRETED;
+#endif
+       }
+
+       if((mb->intrinsic = lookupIntrinsic(mb)) != NULL)
+           mb->trivial = TRIVIAL_INTRINSIC;
+       else
+           findTrivialMethod(mb);
+
        /* Static, private or init methods aren't dynamically invoked, so
          don't stick them in the table to save space */
 
@@ -1216,6 +1463,12 @@ void linkClass(Class *class) {
 
    fastEnableSuspend(self);
 
+   /* Interface methods are only dispatched on classes */
+   if(!(cb->access_flags & ACC_INTERFACE))
+       hashIMethodTable(cb);
+
+   setupSupers(class);
+
    /* if we're an interface all finished - offsets aren't used */
 
    if(!(cb->access_flags & ACC_INTERFACE)) {
@@ -2120,6 +2373,8 @@ void freeClassData(Class *class) {
         }
 
         gcPendingFree(cb->imethod_table);
+        gcPendingFree(cb->imethod_hash);
+        gcPendingFree(cb->secondary_supers);
 
         if(cb->refs_offsets_table != super_cb->refs_offsets_table)
             gcPendingFree(cb->refs_offsets_table);
@@ -40,7 +40,7 @@ void classlibHandleUnmarkedSpecial(Object *ob) {
         /* Free the native thread structure (see comment
            in detachThread (thread.c) */
         TRACE("FREE: Freeing native thread for VMThread object %p\n", ob);
-        gcPendingFree(vmThread2Thread(ob));
+        gcPendingFreeThread(vmThread2Thread(ob));
     }
 }
 
@@ -1210,14 +1210,21 @@ uintptr_t *getThreadInfoForId(Class *class, MethodBlock *mb,
                                           lock_owner);
 
                     if(!exceptionOccurred()) {
+                        /* Times are only available when contention
+                           profiling is enabled (-1 otherwise) */
+                        long long blocked_time = lock_profiling ?
+                                      thread->blocked_time / 1000000 : -1;
+                        long long waited_time = lock_profiling ?
+                                      thread->waited_time / 1000000 : -1;
+
                         helper_info = ARRAY_DATA(*helper_info, Object*);
 
                         executeMethod(info, init, id,
                                       helper_info[0], helper_info[1],
-                                      thread->blocked_count, 0LL,
+                                      thread->blocked_count, blocked_time,
                                       helper_info[2], owner_id,
                                       helper_info[3], thread->waited_count,
-                                      0LL, in_native, FALSE, trace,
+                                      waited_time, in_native, FALSE, trace,
                                       NULL, NULL);
                     }
                 }
@@ -33,7 +33,7 @@ void classlibHandleUnmarkedSpecial(Object *ob) {
         /* Free the native thread structure (see comment
            in detachThread (thread.c) */
         TRACE("FREE: Freeing native thread for java thread object %p\n", ob);
-        gcPendingFree(jThread2Thread(ob));
+        gcPendingFreeThread(jThread2Thread(ob));
     }
 }
 
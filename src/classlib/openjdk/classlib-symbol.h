@@ -34,6 +34,7 @@
     action(flags, "flags"), \
     action(rtype, "rtype"), \
     action(_JI__V, "(JI)V"), \
+    action(_JJJJ__V, "(JJJJ)V"), \
     action(ptypes, "ptypes"), \
     action(invoke, "invoke"), \
     action(target, "target"), \
@@ -69,6 +70,7 @@
     action(uncaughtExceptionHandler, "uncaughtExceptionHandler"), \
     action(java_lang_RuntimeException, "java/lang/RuntimeException"), \
     action(_java_lang_Exception__V, "(Ljava/lang/Exception;)V"), \
+    action(_java_lang_String_ZJJ__V, "(Ljava/lang/String;ZJJ)V"), \
     action(sig_java_util_vector, "Ljava/util/Vector;"), \
     action(array_java_lang_Object, "[Ljava/lang/Object;"), \
     action(initializeSystemClass, "initializeSystemClass"), \
@@ -80,11 +82,16 @@
     action(java_lang_invoke_MethodType, "java/lang/invoke/MethodType"), \
     action(java_lang_invoke_MethodHandle, "java/lang/invoke/MethodHandle"), \
     action(sun_reflect_MagicAccessorImpl, "sun/reflect/MagicAccessorImpl"), \
+    action(sun_management_MemoryPoolImpl, "sun/management/MemoryPoolImpl"), \
     action(java_lang_BootstrapMethodError, "java/lang/BootstrapMethodError"), \
     action(sun_reflect_MethodAccessorImpl, "sun/reflect/MethodAccessorImpl"), \
     action(sig_java_lang_invoke_LambdaForm, "Ljava/lang/invoke/LambdaForm;"), \
     action(sig_java_lang_invoke_MemberName, "Ljava/lang/invoke/MemberName;"), \
     action(sig_sun_reflect_CallerSensitive, "Lsun/reflect/CallerSensitive;"), \
+    action(java_lang_management_MemoryUsage, \
+           "java/lang/management/MemoryUsage"), \
+    action(array_java_lang_management_MemoryPoolMXBean, \
+           "[Ljava/lang/management/MemoryPoolMXBean;"), \
     action(java_lang_invoke_MagicLambdaImpl, \
            "java/lang/invoke/MagicLambdaImpl"), \
     action(sig_java_lang_invoke_MethodHandle, \
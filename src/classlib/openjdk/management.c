@@ -25,7 +25,9 @@
 #include "jni.h"
 #include "jmm.h"
 #include "trace.h"
+#include "excep.h"
 #include "symbol.h"
+#include "lock.h"
 
 jint jmm_GetVersion(JNIEnv *env) {
     return JMM_VERSION_1_0;
@@ -59,8 +61,78 @@ jobjectArray jmm_GetInputArgumentArray(JNIEnv *env) {
     return NULL;
 }
 
+static Object *newMemoryUsage(long long init, long long used,
+                              long long committed, long long max) {
+    MethodBlock *init_mb;
+    Class *usage_class;
+    Object *usage;
+
+    usage_class = findSystemClass(SYMBOL(java_lang_management_MemoryUsage));
+    if(usage_class == NULL)
+        return NULL;
+
+    init_mb = findMethod(usage_class, SYMBOL(object_init), SYMBOL(_JJJJ__V));
+    if(init_mb == NULL) {
+        signalException(java_lang_NoSuchMethodError, "MemoryUsage.<init>");
+        return NULL;
+    }
+
+    if((usage = allocObject(usage_class)) == NULL)
+        return NULL;
+
+    executeMethod(usage, init_mb, init, used, committed, max);
+    return usage;
+}
+
+#ifdef INLINING
+/* The code memory holding inlined code is a non-heap memory pool.
+   Usage thresholds aren't supported, and its collection usage is
+   the usage after the last sweep of cold code (see sweepCodeMemory) */
+static Object *codeMemoryPool() {
+    Class *array_class, *pool_class;
+    Object *array, *pool, *name;
+    MethodBlock *init_mb;
+
+    array_class = findArrayClass(
+                    SYMBOL(array_java_lang_management_MemoryPoolMXBean));
+    pool_class = findSystemClass(SYMBOL(sun_management_MemoryPoolImpl));
+
+    if(array_class == NULL || pool_class == NULL)
+        return NULL;
+
+    init_mb = findMethod(pool_class, SYMBOL(object_init),
+                         SYMBOL(_java_lang_String_ZJJ__V));
+    if(init_mb == NULL) {
+        signalException(java_lang_NoSuchMethodError, "MemoryPoolImpl.<init>");
+        return NULL;
+    }
+
+    if((name = createString("Code Cache")) == NULL ||
+                  (pool = allocObject(pool_class)) == NULL)
+        return NULL;
+
+    executeMethod(pool, init_mb, name, FALSE, -1LL, -1LL);
+    if(exceptionOccurred())
+        return NULL;
+
+    if((array = allocArray(array_class, 1, sizeof(Object*))) == NULL)
+        return NULL;
+
+    ARRAY_DATA(array, Object*)[0] = pool;
+    return array;
+}
+#endif
+
 jobjectArray jmm_GetMemoryPools(JNIEnv *env, jobject obj) {
-    Class *array_class = findArrayClass(SYMBOL(array_java_lang_String));
+    Class *array_class;
+
+#ifdef INLINING
+    /* No pools belong to a memory manager */
+    if(obj == NULL)
+        return codeMemoryPool();
+#endif
+
+    array_class = findArrayClass(SYMBOL(array_java_lang_String));
 
     if(array_class == NULL)
         return NULL;
@@ -77,19 +149,42 @@ jobjectArray jmm_GetMemoryManagers(JNIEnv *env, jobject obj) {
      return allocArray(array_class, 0, sizeof(Object*));
 }
 
+/* The only pool is the code memory */
+
 jobject jmm_GetMemoryPoolUsage(JNIEnv *env, jobject obj) {
+#ifdef INLINING
+    long long used, committed, max;
+
+    codeMemoryUsage(&used, &committed, &max);
+    return newMemoryUsage(-1, used, committed, max);
+#else
     UNIMPLEMENTED("jmm_GetMemoryPoolUsage");
     return NULL;
+#endif
 }
 
 jobject jmm_GetPeakMemoryPoolUsage(JNIEnv *env, jobject obj) {
+#ifdef INLINING
+    long long used, committed, max;
+
+    codeMemoryUsage(&used, &committed, &max);
+    return newMemoryUsage(-1, peakCodeMem(), committed, max);
+#else
     UNIMPLEMENTED("jmm_GetPeakMemoryPoolUsage");
     return NULL;
+#endif
 }
 
 jobject jmm_GetPoolCollectionUsage(JNIEnv *env, jobject obj) {
+#ifdef INLINING
+    long long used, committed, max;
+
+    codeMemoryUsage(&used, &committed, &max);
+    return newMemoryUsage(-1, sweptCodeMem(), committed, max);
+#else
     UNIMPLEMENTED("jmm_GetPoolCollectionUsage");
     return NULL;
+#endif
 }
 
 void jmm_SetPoolSensor(JNIEnv *env, jobject obj, jmmThresholdType type,
@@ -106,17 +201,47 @@ jlong jmm_SetPoolThreshold(JNIEnv *env, jobject obj, jmmThresholdType type,
 }
 
 jobject jmm_GetMemoryUsage(JNIEnv *env, jboolean heap) {
-    UNIMPLEMENTED("jmm_GetMemoryUsage");
-    return NULL;
+    long long init, used, committed, max;
+
+    TRACE("jmm_GetMemoryUsage(env=%p, heap=%d)", env, heap);
+
+    if(heap) {
+        init = committed = totalHeapMem();
+        used = committed - freeHeapMem();
+        max = maxHeapMem();
+    } else {
+        /* Non-heap memory is the Java thread stacks (and the
+           inlined code memory).  Stack pages are only committed
+           as a thread's stack grows, up to the reserved maximum */
+        javaStackMemoryUsage(&committed, &max);
+        init = -1;
+        used = committed;
+
+#ifdef INLINING
+        /* Plus the code memory holding inlined code */
+        {
+            long long code_used, code_committed, code_max;
+
+            codeMemoryUsage(&code_used, &code_committed, &code_max);
+            used += code_used;
+            committed += code_committed;
+            max += code_max;
+        }
+#endif
+    }
+
+    return newMemoryUsage(init, used, committed, max);
 }
 
 jboolean jmm_GetBoolAttribute(JNIEnv *env, jmmBoolAttribute att) {
     TRACE("jmm_GetBoolAttribute(env=%p, att=%d)", env, att);
 
     switch (att) {
+        case JMM_THREAD_CONTENTION_MONITORING:
+            return lock_profiling;
+
         case JMM_VERBOSE_GC:
         case JMM_VERBOSE_CLASS:
-        case JMM_THREAD_CONTENTION_MONITORING:
         case JMM_THREAD_CPU_TIME:
         case JMM_THREAD_ALLOCATED_MEMORY:
             break;
@@ -135,9 +260,12 @@ jboolean jmm_SetBoolAttribute(JNIEnv *env, jmmBoolAttribute att,
     TRACE("jmm_SetBoolAttribute(env=%p, att=%d, flag=%d)", env, att, flag);
 
     switch (att) {
+        case JMM_THREAD_CONTENTION_MONITORING:
+            setLockProfiling(flag);
+            return TRUE;
+
         case JMM_VERBOSE_GC:
         case JMM_VERBOSE_CLASS:
-        case JMM_THREAD_CONTENTION_MONITORING:
         case JMM_THREAD_CPU_TIME:
         case JMM_THREAD_ALLOCATED_MEMORY:
             break;
@@ -264,7 +264,7 @@ void cachePolyOffsets(CachedPolyOffsets *cpo) {
 #define REFERENCE_KIND_MASK  (0xf000000 >> REFERENCE_KIND_SHIFT)
 
 static int stackOverflowCheck(ExecEnv *ee, char *sp) {
-    if(sp > ee->stack_end) {
+    if(sp > ee->stack_end && !growJavaStack(ee, sp)) {
         if(ee->overflow++) {
             /* Overflow when we're already throwing stack
                overflow.  Stack extension should be enough
@@ -273,7 +273,7 @@ static int stackOverflowCheck(ExecEnv *ee, char *sp) {
             jam_fprintf(stderr, "Fatal stack overflow!  Aborting VM.\n");
             exitVM(1);
         }
-        ee->stack_end += STACK_RED_ZONE_SIZE;
+        useStackRedZone(ee);
         signalException(java_lang_StackOverflowError, NULL);
         return TRUE;
     }
@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Sampling CPU profiler.  A profiling timer (SIGPROF) interrupts the
+   thread using the CPU, and the signal handler records the thread's
+   Java stack (method and pc of each frame) into a per-thread ring
+   buffer.  The handler doesn't lock, allocate or call any function
+   which isn't async-signal-safe.  Each buffer has a single writer
+   (the thread itself, in the handler) and a single reader, so the
+   ring is lock-free.
+
+   The buffers are drained periodically by the profiler thread, and
+   also on thread exit and at the start of each GC (so a sample never
+   refers to a method whose class has been unloaded).  Draining maps
+   each sample to a stack of method names and line numbers, and counts
+   identical stacks.  At exit the counts are written in the "collapsed
+   stack" format used by flame graph tools: one line per stack, with
+   the frames root first, separated by semi-colons, followed by the
+   count */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "jam.h"
+#include "thread.h"
+
+/* Size of each thread's ring buffer in words.  Must be a power of 2 */
+#define PROF_BUFFER_SIZE 16384
+#define PROF_BUFFER_MASK (PROF_BUFFER_SIZE - 1)
+
+/* Frames recorded per-sample.  Deeper stacks lose their root frames */
+#define PROF_MAX_DEPTH 128
+
+/* A sample is a header word (the depth and a truncated flag),
+   followed by a method and pc for each frame, from the leaf */
+#define SAMPLE_WORDS (1 + PROF_MAX_DEPTH * 2)
+
+#define PROF_TABLE_SIZE 4096
+#define STACK_BUFF_SIZE 8192
+
+/* How often the profiler thread drains the buffers (in ms) */
+#define DRAIN_INTERVAL 100
+
+typedef struct prof_buffer {
+    volatile unsigned int head;
+    volatile unsigned int tail;
+    volatile unsigned int dropped;
+    struct prof_buffer *prev, *next;
+    uintptr_t data[PROF_BUFFER_SIZE];
+} ProfBuffer;
+
+typedef struct prof_stack {
+    char *stack;
+    int hash;
+    long long count;
+    struct prof_stack *next;
+} ProfStack;
+
+int cpu_profiling = FALSE;
+
+static char *prof_file;
+static int prof_interval;
+
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProfBuffer *buffers = NULL;
+static ProfStack *stack_table[PROF_TABLE_SIZE];
+static long long total_samples = 0;
+static long long total_dropped = 0;
+
+static void profileHandler(int sig) {
+    Thread *self = threadSelf();
+    unsigned int head, start;
+    ProfBuffer *buff;
+    int depth = 0, truncated = FALSE;
+    ExecEnv *ee;
+    Frame *last;
+
+    if(self == NULL || (buff = self->prof_buffer) == NULL)
+        return;
+
+    head = buff->head;
+    if(PROF_BUFFER_SIZE - (head - buff->tail) < SAMPLE_WORDS) {
+        buff->dropped++;
+        return;
+    }
+
+    /* The thread may have been interrupted while pushing a frame,
+       so only follow frames within the thread's stack, and which
+       are below the current frame */
+    ee = self->ee;
+    start = head++;
+
+    for(last = ee->last_frame;
+            (char*)last >= ee->stack &&
+            (char*)(last + 1) <= ee->stack + ee->stack_max &&
+            last->prev != NULL && last->prev < last;
+            last = last->prev) {
+
+        if(last->mb == NULL)
+            continue;
+
+        if(depth == PROF_MAX_DEPTH) {
+            truncated = TRUE;
+            break;
+        }
+
+        buff->data[head++ & PROF_BUFFER_MASK] = (uintptr_t)last->mb;
+        buff->data[head++ & PROF_BUFFER_MASK] = (uintptr_t)last->last_pc;
+        depth++;
+    }
+
+    buff->data[start & PROF_BUFFER_MASK] = depth << 1 | truncated;
+
+    MBARRIER();
+    buff->head = head;
+}
+
+static void addStack(char *stack) {
+    ProfStack *entry;
+    int hash = 0;
+    char *pntr;
+
+    for(pntr = stack; *pntr; pntr++)
+        hash = hash * 31 + *pntr;
+
+    for(entry = stack_table[hash & (PROF_TABLE_SIZE - 1)];
+        entry != NULL; entry = entry->next)
+        if(entry->hash == hash && strcmp(entry->stack, stack) == 0) {
+            entry->count++;
+            return;
+        }
+
+    entry = sysMalloc(sizeof(ProfStack));
+    entry->stack = strcpy(sysMalloc(strlen(stack) + 1), stack);
+    entry->hash = hash;
+    entry->count = 1;
+
+    entry->next = stack_table[hash & (PROF_TABLE_SIZE - 1)];
+    stack_table[hash & (PROF_TABLE_SIZE - 1)] = entry;
+}
+
+/* Convert a sample to a collapsed stack.  The leaf frame has no line
+   number, as the frame's pc is only saved when it calls a method or
+   may throw an exception */
+
+static void symbolizeSample(uintptr_t *data, unsigned int pos, int depth,
+                            int truncated, char *buff) {
+    char *end = buff + STACK_BUFF_SIZE - 1;
+    char *pntr = buff;
+    int i;
+
+    if(depth == 0) {
+        strcpy(buff, "[VM]");
+        return;
+    }
+
+    if(truncated)
+        pntr += sprintf(pntr, "[truncated];");
+
+    for(i = depth - 1; i >= 0 && pntr < end - 1; i--) {
+        unsigned int idx = pos + i * 2;
+        MethodBlock *mb = (MethodBlock*)data[idx & PROF_BUFFER_MASK];
+        CodePntr pc = (CodePntr)data[(idx + 1) & PROF_BUFFER_MASK];
+        int line = -1;
+
+        slash2DotsBuff(CLASS_CB(mb->class)->name, pntr, end - pntr);
+        pntr += strlen(pntr);
+
+        if(i > 0 && !(mb->access_flags & ACC_NATIVE))
+            line = mapPC2LineNo(mb, pc);
+
+        if(line >= 0)
+            pntr += snprintf(pntr, end - pntr, ".%s:%d", mb->name, line);
+        else
+            pntr += snprintf(pntr, end - pntr, ".%s", mb->name);
+
+        if(pntr > end)
+            pntr = end;
+
+        if(i > 0 && pntr < end)
+            *pntr++ = ';';
+    }
+
+    *pntr = '\0';
+}
+
+/* Called with the profile lock held */
+static void drainBuffer(ProfBuffer *buff) {
+    char stack[STACK_BUFF_SIZE];
+    unsigned int tail = buff->tail;
+    unsigned int head = buff->head;
+
+    MBARRIER();
+
+    while(tail != head) {
+        uintptr_t header = buff->data[tail++ & PROF_BUFFER_MASK];
+        int depth = header >> 1;
+
+        symbolizeSample(buff->data, tail, depth, header & 1, stack);
+        addStack(stack);
+        total_samples++;
+
+        tail += depth * 2;
+    }
+
+    MBARRIER();
+    buff->tail = tail;
+}
+
+static void drainBuffers() {
+    ProfBuffer *buff;
+
+    pthread_mutex_lock(&prof_lock);
+
+    for(buff = buffers; buff != NULL; buff = buff->next)
+        drainBuffer(buff);
+
+    pthread_mutex_unlock(&prof_lock);
+}
+
+/* Called by the GC, before any classes are unloaded */
+void drainCPUProfile() {
+    if(cpu_profiling)
+        drainBuffers();
+}
+
+void cpuProfileAttachThread(Thread *thread) {
+    ProfBuffer *buff = sysMalloc(sizeof(ProfBuffer));
+
+    buff->head = buff->tail = buff->dropped = 0;
+    buff->prev = NULL;
+
+    pthread_mutex_lock(&prof_lock);
+
+    if((buff->next = buffers) != NULL)
+        buffers->prev = buff;
+    buffers = buff;
+
+    pthread_mutex_unlock(&prof_lock);
+
+    thread->prof_buffer = buff;
+}
+
+/* Called by the thread itself when it detaches from the VM.
+   The thread is about to exit, so it blocks the profiling
+   signal rather than restoring it afterwards */
+
+void cpuProfileDetachThread(Thread *thread) {
+    ProfBuffer *buff = thread->prof_buffer;
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    thread->prof_buffer = NULL;
+
+    pthread_mutex_lock(&prof_lock);
+
+    drainBuffer(buff);
+    total_dropped += buff->dropped;
+
+    if(buff->prev != NULL)
+        buff->prev->next = buff->next;
+    else
+        buffers = buff->next;
+
+    if(buff->next != NULL)
+        buff->next->prev = buff->prev;
+
+    pthread_mutex_unlock(&prof_lock);
+
+    sysFree(buff);
+}
+
+static void profilerThreadLoop(Thread *self) {
+    for(;;) {
+        threadSleep(self, DRAIN_INTERVAL, 0);
+
+        /* Classes can't be unloaded while draining */
+        fastDisableSuspend(self);
+        drainBuffers();
+        fastEnableSuspend(self);
+    }
+}
+
+static void setProfileTimer(int interval) {
+    struct itimerval timer;
+
+    timer.it_interval.tv_sec = interval / 1000000;
+    timer.it_interval.tv_usec = interval % 1000000;
+    timer.it_value = timer.it_interval;
+
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+void shutdownCPUProfile() {
+    Thread *self = threadSelf();
+    ProfBuffer *buff;
+    long long dropped;
+    FILE *file;
+    int i;
+
+    if(!cpu_profiling)
+        return;
+
+    setProfileTimer(0);
+
+    fastDisableSuspend(self);
+    pthread_mutex_lock(&prof_lock);
+
+    dropped = total_dropped;
+    for(buff = buffers; buff != NULL; buff = buff->next) {
+        drainBuffer(buff);
+        dropped += buff->dropped;
+    }
+
+    if((file = fopen(prof_file, "w")) == NULL)
+        jam_fprintf(stderr, "Couldn't open CPU profile file %s\n", prof_file);
+    else {
+        for(i = 0; i < PROF_TABLE_SIZE; i++) {
+            ProfStack *entry;
+
+            for(entry = stack_table[i]; entry != NULL; entry = entry->next)
+                fprintf(file, "%s %lld\n", entry->stack, entry->count);
+        }
+
+        fclose(file);
+    }
+
+    if(dropped != 0)
+        jam_fprintf(stderr, "CPU profile: %lld samples, %lld dropped\n",
+                    total_samples, dropped);
+
+    pthread_mutex_unlock(&prof_lock);
+    fastEnableSuspend(self);
+}
+
+int initialiseCPUProfileThread() {
+    if(cpu_profiling)
+        createVMThread("CPU Profiler", profilerThreadLoop);
+
+    return TRUE;
+}
+
+int initialiseCPUProfile(InitArgs *args) {
+    struct sigaction act;
+
+    if(args->prof_file == NULL)
+        return TRUE;
+
+    prof_file = args->prof_file;
+    prof_interval = args->prof_interval;
+    cpu_profiling = TRUE;
+
+    /* Threads created from now on are given a buffer when
+       they're initialised.  The main thread already exists */
+    cpuProfileAttachThread(threadSelf());
+
+    act.sa_handler = profileHandler;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &act, NULL);
+
+    setProfileTimer(prof_interval);
+    return TRUE;
+}
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "jam.h"
 #include "lock.h"
 #include "symbol.h"
@@ -36,14 +37,19 @@ static int inited = FALSE;
 
 static Class *exceptions[MAX_EXCEPTION_ENUM];
 
+/* Maximum number of frames captured in a stack trace */
+static int max_trace_depth;
+
 static int exception_symbols[] = {
     CLASSLIB_EXCEPTIONS_DO(SYMBOL_NAME_ENUM)
     EXCEPTIONS_DO(SYMBOL_NAME_ENUM)
 };
 
-int initialiseException() {
+int initialiseException(InitArgs *args) {
     int i;
 
+    max_trace_depth = args->max_trace_depth;
+
     ste_array_class = findArrayClass(SYMBOL(array_java_lang_StackTraceElement));
     ste_class = findSystemClass0(SYMBOL(java_lang_StackTraceElement));
     throw_class = findSystemClass0(SYMBOL(java_lang_Throwable));
@@ -89,7 +95,7 @@ void clearException() {
 
     if(ee->overflow) {
         ee->overflow = FALSE;
-        ee->stack_end -= STACK_RED_ZONE_SIZE;
+        releaseStackRedZone(ee);
     }
     ee->exception = NULL;
 }
@@ -173,8 +179,8 @@ void printException() {
     }
 }
 
-CodePntr findCatchBlockInMethod(MethodBlock *mb, Class *exception,
-                                CodePntr pc_pntr) {
+static CodePntr findCatchBlockInMethod0(MethodBlock *mb, Class *exception,
+                                        CodePntr pc_pntr, int *unresolved) {
 
     ExceptionTableEntry *table = mb->exception_table;
     int size = mb->exception_table_size;
@@ -194,6 +200,7 @@ CodePntr findCatchBlockInMethod(MethodBlock *mb, Class *exception,
                                                    TRUE, FALSE);
                 if(caught_class == NULL) {
                     clearException();
+                    *unresolved = TRUE;
                     continue;
                 }
                 if(!isInstanceOf(caught_class, exception))
@@ -204,13 +211,64 @@ CodePntr findCatchBlockInMethod(MethodBlock *mb, Class *exception,
 
     return NULL;
 }
+
+CodePntr findCatchBlockInMethod(MethodBlock *mb, Class *exception,
+                                CodePntr pc_pntr) {
+    int unresolved;
+
+    return findCatchBlockInMethod0(mb, exception, pc_pntr, &unresolved);
+}
     
+/* The catch caches hold class and method references which are
+   invalidated by garbage collection (classes may be moved or
+   unloaded).  Rather than visiting each thread, the GC increments
+   the epoch, and only entries from the current epoch match */
+
+static volatile int catch_cache_epoch = 1;
+
+void flushCatchCaches() {
+    catch_cache_epoch++;
+}
+
+static CodePntr findCachedCatchBlock(ExecEnv *ee, MethodBlock *mb,
+                                     Class *exception, CodePntr pc) {
+
+    int idx = (((uintptr_t)pc >> 2) ^ ((uintptr_t)exception >> 4))
+                  & (CATCH_CACHE_SIZE-1);
+    CatchCacheEntry *entry = &ee->catch_cache[idx];
+    int epoch = catch_cache_epoch;
+    int unresolved = FALSE;
+    CodePntr handler_pc;
+
+    if(entry->pc == pc && entry->mb == mb && entry->exception == exception
+                       && entry->epoch == epoch)
+        return entry->handler;
+
+    handler_pc = findCatchBlockInMethod0(mb, exception, pc, &unresolved);
+
+    /* Don't cache the result if a catch type failed
+       to resolve, as resolution may succeed later */
+    if(unresolved)
+        return handler_pc;
+
+    /* The epoch is the one read before the lookup, which
+       may have resolved a class and garbage collected */
+    entry->pc = pc;
+    entry->mb = mb;
+    entry->exception = exception;
+    entry->handler = handler_pc;
+    entry->epoch = epoch;
+
+    return handler_pc;
+}
+
 CodePntr findCatchBlock(Class *exception) {
-    Frame *frame = getExecEnv()->last_frame;
+    ExecEnv *ee = getExecEnv();
+    Frame *frame = ee->last_frame;
     CodePntr handler_pc = NULL;
 
-    while(((handler_pc = findCatchBlockInMethod(frame->mb, exception,
-                                                frame->last_pc)) == NULL)
+    while(((handler_pc = findCachedCatchBlock(ee, frame->mb, exception,
+                                              frame->last_pc)) == NULL)
                     && (frame->prev->mb != NULL)) {
 
         if(frame->mb->access_flags & ACC_SYNCHRONIZED) {
@@ -221,7 +279,7 @@ CodePntr findCatchBlock(Class *exception) {
         frame = frame->prev;
     }
 
-    getExecEnv()->last_frame = frame;
+    ee->last_frame = frame;
 
     return handler_pc;
 }
@@ -264,21 +322,33 @@ out:
     return depth;
 }
 
-void stackTrace2Buffer(Frame *last, void **data, int max_depth) {
+/* Returns the number of frames written, or max_depth + 1
+   if the stack is deeper than max_depth */
+int stackTrace2Buffer(Frame *last, void **data, int max_depth) {
     int limit = max_depth * 2, depth = 0;
 
     do {
         for(; last->mb != NULL; last = last->prev) {
             if(depth == limit)
-                return;
+                return max_depth + 1;
 
             data[depth++] = last->mb;
             data[depth++] = last->last_pc;
         }
     } while((last = last->prev)->prev != NULL);
+
+    return depth / 2;
 }
 
+/* A stack trace is captured as an array of method and pc pairs.
+   Stack trace elements are only created from this if the trace is
+   requested (see stackTraceElements).  The trace is usually shallow
+   enough to be captured in one walk of the stack into a buffer on
+   the C stack.  Otherwise, the frames are counted, and captured
+   directly into the array */
+
 Object *stackTrace(ExecEnv *ee, int max_depth) {
+    void *buff[TRACE_BUFFER_DEPTH * 2];
     Frame *last = ee->last_frame;
     Object *array;
     void **data;
@@ -286,16 +356,31 @@ Object *stackTrace(ExecEnv *ee, int max_depth) {
 
     if(last->prev == NULL)
         return allocTypeArray(sizeof(uintptr_t) == 4 ? T_INT : T_LONG, 0);
-    
+
+    if(max_depth > max_trace_depth)
+        max_depth = max_trace_depth;
+
     last = skipExceptionFrames(last);
-    depth = countStackFrames(last, max_depth);
+    depth = stackTrace2Buffer(last, buff, max_depth < TRACE_BUFFER_DEPTH ?
+                                          max_depth : TRACE_BUFFER_DEPTH);
+
+    if(depth > TRACE_BUFFER_DEPTH)
+        depth = countStackFrames(last, max_depth);
+    else if(depth > max_depth)
+        depth = max_depth;
 
     array = allocTypeArray(sizeof(uintptr_t) == 4 ? T_INT : T_LONG, depth*2);
     if(array == NULL)
         return NULL;
 
     data = ARRAY_DATA(array, void *);
-    stackTrace2Buffer(last, data, depth);
+
+    /* The methods and pcs remain valid across a GC in the
+       allocation, as the frames are still on the stack */
+    if(depth > TRACE_BUFFER_DEPTH)
+        stackTrace2Buffer(last, data, depth);
+    else
+        memcpy(data, buff, depth * 2 * sizeof(void*));
 
     return array;
 }
@@ -29,12 +29,15 @@
     Frame *dummy = (Frame *)(last->ostack+last->mb->max_stack); \
     Frame *new_frame;                                           \
     uintptr_t *new_ostack;                                      \
+    char *frame_end;                                            \
                                                                 \
     ret = (void*) (sp = (uintptr_t*)(dummy+1));                 \
     new_frame = (Frame *)(sp + mb->max_locals);                 \
     new_ostack = ALIGN_OSTACK(new_frame + 1);                   \
+    frame_end = (char*)(new_ostack + mb->max_stack);            \
                                                                 \
-    if((char*)(new_ostack + mb->max_stack) > ee->stack_end) {   \
+    if(__builtin_expect(frame_end > ee->stack_end, FALSE) &&    \
+                  !growJavaStack(ee, frame_end)) {              \
         if(ee->overflow++) {                                    \
             /* Overflow when we're already throwing stack       \
                overflow.  Stack extension should be enough      \
@@ -43,7 +46,7 @@
             printf("Fatal stack overflow!  Aborting VM.\n");    \
             exitVM(1);                                          \
         }                                                       \
-        ee->stack_end += STACK_RED_ZONE_SIZE;                   \
+        useStackRedZone(ee);                                    \
         signalException(java_lang_StackOverflowError, NULL);    \
         return NULL;                                            \
     }                                                           \
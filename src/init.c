@@ -50,6 +50,15 @@ void setDefaultInitArgs(InitArgs *args) {
     args->trace_jni_sigs = FALSE;
     args->compact_specified = FALSE;
 
+    args->lock_profile_report = 0;
+    args->lock_profile_sample = 1;
+
+    args->prof_file = NULL;
+    args->prof_interval = 10000;
+
+    args->intrinsics = TRUE;
+    args->max_trace_depth = INT_MAX;
+
     args->classpath  = NULL;
     args->bootpath   = NULL;
     args->bootpath_p = NULL;
@@ -58,6 +67,7 @@ void setDefaultInitArgs(InitArgs *args) {
     args->bootpath_v = NULL;
 
     args->java_stack = DEFAULT_STACK;
+    args->max_java_stack = DEFAULT_MAX_STACK;
     args->max_heap   = phys_mem == 0 ? DEFAULT_MAX_HEAP
                                      : clampHeapLimit(phys_mem/4);
     args->min_heap   = phys_mem == 0 ? DEFAULT_MIN_HEAP
@@ -77,12 +87,22 @@ void setDefaultInitArgs(InitArgs *args) {
     args->print_codestats       = FALSE;
     args->join_blocks           = TRUE;
     args->profiling             = TRUE;
+    args->background_inlining   = TRUE;
+    args->perf_map              = FALSE;
     args->codemem               = args->max_heap/4;
 #endif
 
 #ifdef HAVE_PROFILE_STUBS
     args->dump_stubs_profiles   = FALSE;
 #endif
+
+#ifdef OPCODE_STATS
+    args->opcode_stats_report   = 0;
+#endif
+
+#ifdef PREPARE_CACHE
+    args->prepare_cache         = NULL;
+#endif
 }
 
 int VMInitialising() {
@@ -103,19 +123,33 @@ int initVM(InitArgs *args) {
              initialiseThreadStage1(args) &&
              initialiseUtf8() &&
              initialiseSymbol() &&
+             initialiseIntrinsics(args) &&
              initialiseClassStage1(args) &&
              initialiseDll(args) &&
              initialiseMonitor() &&
+             initialiseLockProfile(args) &&
+             initialiseCPUProfile(args) &&
              initialiseString() &&
-             initialiseException() &&
+             initialiseException(args) &&
              initialiseNatives() &&
              initialiseAccess() &&
              initialiseFrame() &&
              initialiseJNI() &&
              initialiseInterpreter(args) &&
+#ifdef OPCODE_STATS
+             initialiseOpcodeStats(args) &&
+#endif
+#ifdef PREPARE_CACHE
+             initialisePrepareCache(args) &&
+#endif
              initialiseClassStage2() &&
              initialiseThreadStage2(args) &&
-             initialiseGC(args);
+             initialiseGC(args) &&
+             initialiseCPUProfileThread()
+#ifdef INLINING
+             && initialiseInliningThread()
+#endif
+             ;
 
     VM_initing = FALSE;
     return status;
@@ -173,7 +207,6 @@ static CompatOptions compat[] = {
     {"-dsa",                     OPT_NOARG},
     {"-Xrs",                     OPT_NOARG},
     {"-Xint",                    OPT_NOARG},
-    {"-Xprof",                   OPT_NOARG},
     {"-Xcomp",                   OPT_NOARG},
     {"-Xbatch",                  OPT_NOARG},
     {"-Xmixed",                  OPT_NOARG},
@@ -219,6 +252,15 @@ int parseCommonOpts(char *string, InitArgs *args, int is_jni) {
             status = OPT_ERROR;
         }
 
+    } else if(strncmp(string, "-Xssmax", 7) == 0) {
+        args->max_java_stack = parseMemValue(string + 7);
+
+        if(args->max_java_stack < MIN_STACK) {
+            optError(args, "Invalid maximum Java stack size: %s "
+                     "(min is %dK)\n", string, MIN_STACK/KB);
+            status = OPT_ERROR;
+        }
+
     } else if(strncmp(string, "-Xss", 4) == 0 ||
               (!is_jni && strncmp(string, "-ss", 3) == 0)) {
 
@@ -260,6 +302,67 @@ int parseCommonOpts(char *string, InitArgs *args, int is_jni) {
 
     } else if(strcmp(string, "-Xtracejnisigs") == 0) {
         args->trace_jni_sigs = TRUE;
+
+    } else if(strncmp(string, "-Xlockprof", 10) == 0 &&
+              (string[10] == '\0' || string[10] == ':')) {
+        char *pntr = string + 10;
+
+        args->lock_profile_report = 20;
+
+        if(*pntr == ':') {
+            args->lock_profile_report = strtol(pntr + 1, &pntr, 0);
+
+            if(*pntr == ',')
+                args->lock_profile_sample = strtol(pntr + 1, &pntr, 0);
+        }
+
+        if(*pntr != '\0' || args->lock_profile_report <= 0 ||
+                             args->lock_profile_sample <= 0) {
+            optError(args, "Invalid lock profile option: %s\n", string);
+            status = OPT_ERROR;
+        }
+
+    } else if(strncmp(string, "-Xprof", 6) == 0 &&
+              (string[6] == '\0' || string[6] == ':')) {
+        char *pntr = string + 6;
+
+        args->prof_file = "jamvm.prof";
+
+        if(*pntr == ':')
+            do {
+                pntr++;
+
+                if(strncmp(pntr, "file=", 5) == 0) {
+                    int len = strcspn(pntr += 5, ",");
+
+                    args->prof_file = strncpy(sysMalloc(len + 1), pntr, len);
+                    args->prof_file[len] = '\0';
+                    pntr += len;
+                } else if(strncmp(pntr, "interval=", 9) == 0)
+                    args->prof_interval = strtol(pntr + 9, &pntr, 0);
+                else
+                    break;
+            } while(*pntr == ',');
+
+        if(*pntr != '\0' || *args->prof_file == '\0' ||
+                             args->prof_interval <= 0) {
+            optError(args, "Invalid CPU profile option: %s\n", string);
+            status = OPT_ERROR;
+        }
+
+    } else if(strcmp(string, "-Xnointrinsics") == 0) {
+        args->intrinsics = FALSE;
+
+    } else if(strncmp(string, "-Xmaxtracedepth:", 16) == 0) {
+        char *end;
+
+        args->max_trace_depth = strtol(string + 16, &end, 0);
+
+        if(*end != '\0' || args->max_trace_depth < 0) {
+            optError(args, "Invalid stack trace depth: %s\n", string);
+            status = OPT_ERROR;
+        } else if(args->max_trace_depth == 0)
+            args->max_trace_depth = INT_MAX;
 #ifdef INLINING
     } else if(strcmp(string, "-Xnoinlining") == 0) {
         /* Turning inlining off is equivalent to setting
@@ -269,6 +372,9 @@ int parseCommonOpts(char *string, InitArgs *args, int is_jni) {
     } else if(strcmp(string, "-Xnoprofiling") == 0) {
         args->profiling = FALSE;
 
+    } else if(strcmp(string, "-Xnobackgroundinlining") == 0) {
+        args->background_inlining = FALSE;
+
     } else if(strcmp(string, "-Xnopatching") == 0) {
         args->branch_patching = FALSE;
 
@@ -278,6 +384,9 @@ int parseCommonOpts(char *string, InitArgs *args, int is_jni) {
     } else if(strcmp(string, "-Xnojoinblocks") == 0) {
         args->join_blocks = FALSE;
 
+    } else if(strcmp(string, "-Xperfmap") == 0) {
+        args->perf_map = TRUE;
+
     } else if(strcmp(string, "-Xcodestats") == 0) {
         args->print_codestats = TRUE;
 
@@ -309,6 +418,27 @@ int parseCommonOpts(char *string, InitArgs *args, int is_jni) {
     } else if(strcmp(string, "-Xdumpstubsprofiles") == 0) {
         args->dump_stubs_profiles = TRUE;
 #endif
+
+#ifdef OPCODE_STATS
+    } else if(strncmp(string, "-Xopcodestats", 13) == 0 &&
+              (string[13] == '\0' || string[13] == ':')) {
+        char *end = string + 13;
+
+        args->opcode_stats_report = 20;
+
+        if(*end == ':')
+            args->opcode_stats_report = strtol(end + 1, &end, 0);
+
+        if(*end != '\0' || args->opcode_stats_report <= 0) {
+            optError(args, "Invalid opcode statistics option: %s\n", string);
+            status = OPT_ERROR;
+        }
+#endif
+
+#ifdef PREPARE_CACHE
+    } else if(strncmp(string, "-Xprepcache:", 12) == 0 && string[12] != '\0') {
+        args->prepare_cache = string + 12;
+#endif
     /* Compatibility options */
     } else {
         int i;
@@ -24,6 +24,7 @@
 
 #ifdef DIRECT
 #include <stdio.h>
+#include <stdlib.h>
 #include <arpa/inet.h>
 #include <string.h>
 
@@ -53,8 +54,15 @@
    has not been calculated yet */
 #define DEPTH_UNKNOWN -1
 
-/* Global lock for method preparation */
-static VMWaitLock prepare_lock;
+/* Locks for method preparation.  A method uses the lock selected
+   by its address, so threads preparing unrelated methods rarely
+   share a lock.  Must be a power of 2 */
+#define PREPARE_LOCKS 64
+
+#define PREPARE_LOCK_INDEX(mb) \
+    (((uintptr_t)(mb) / sizeof(MethodBlock)) & (PREPARE_LOCKS - 1))
+
+static VMWaitLock prepare_locks[PREPARE_LOCKS];
 
 #ifdef INLINING
 int inlining_enabled;
@@ -62,17 +70,115 @@ static int join_blocks;
 #endif
 
 void initialiseDirect(InitArgs *args) {
+    int i;
+
 #ifdef INLINING
     inlining_enabled = initialiseInlining(args);
     join_blocks      = args->join_blocks;
 #endif
-    initVMWaitLock(prepare_lock);
+
+    for(i = 0; i < PREPARE_LOCKS; i++)
+        initVMWaitLock(prepare_locks[i]);
+}
+
+/* The entries of a lookupswitch are sorted so they can be binary
+   searched.  A lookupswitch whose keys fill at least half their
+   range is converted into a tableswitch, with the missing keys
+   branching to the default */
+
+static int compareLookupEntries(const void *pntr1, const void *pntr2) {
+    int key1 = ((LookupEntry*)pntr1)->key;
+    int key2 = ((LookupEntry*)pntr2)->key;
+
+    return key1 < key2 ? -1 : key1 > key2;
+}
+
+static int isDenseLookupSwitch(LookupEntry *entries, int npairs) {
+    long long range;
+
+    if(npairs == 0)
+        return FALSE;
+
+    range = (long long)entries[npairs - 1].key - entries[0].key + 1;
+    return range <= (long long)npairs * 2;
+}
+
+#ifdef SUPER_INSNS
+/* Static superinstructions execute a sequence of simple instructions
+   with one dispatch.  A sequence is matched by the instructions'
+   handlers (opcodes sharing a handler are equivalent), and the handler
+   of the first instruction is replaced.  The other instructions are
+   unchanged, so a branch into the middle of a sequence executes the
+   remaining instructions normally.  The patterns are ordered longest
+   first.
+
+   With stack-caching, each instruction is matched at the cache depth
+   it was prepared with.  A superinstruction leaves the cache at a
+   fixed depth for each entry depth (exit_depth), so a sequence is only
+   replaced if this is the depth of the following instruction */
+
+typedef struct super_insn {
+    int opcode;
+    int length;
+    int exit_depth[3];
+    int sequence[SUPER_INSN_MAX_LEN];
+} SuperInsn;
+
+static SuperInsn super_insns[] = {
+    SUPER_INSN_PATTERNS
+};
+
+/* A superinstruction replaces the handler of the first instruction
+   in its sequence, and keeps that instruction's operand */
+
+int superInsnFirstOpcode(int opcode) {
+    int i;
+
+    for(i = 0; i < SUPER_INSNS_COUNT; i++)
+        if(super_insns[i].opcode == opcode)
+            return super_insns[i].sequence[0];
+
+    return opcode;
+}
+
+#ifdef USE_CACHE
+#define INS_DEPTH(idx) ins_depth[idx]
+#else
+#define INS_DEPTH(idx) 0
+#endif
+
+static void selectSuperInsns(Instruction *code, int code_len,
+                             const void ***handlers,
+                             signed char *ins_depth) {
+    int i, j, k;
+
+    for(i = 0; i < code_len; i++)
+        for(j = 0; j < SUPER_INSNS_COUNT; j++) {
+            SuperInsn *super = &super_insns[j];
+            int depth = INS_DEPTH(i);
+
+            if(i + super->length >= code_len || INS_DEPTH(i + super->length)
+                                        != super->exit_depth[depth])
+                continue;
+
+            for(k = 0; k < super->length && code[i + k].handler ==
+                  handlers[INS_DEPTH(i + k)][super->sequence[k]]; k++);
+
+            if(k == super->length) {
+                code[i].handler = handlers[depth][super->opcode];
+                break;
+            }
+        }
 }
+#endif
 
 void prepare(MethodBlock *mb, const void ***handlers) {
     int code_len = mb->code_size;
 #ifdef USE_CACHE
     signed char cache_depth[code_len + 1];
+#ifdef SUPER_INSNS
+    signed char ins_depth[code_len];
+#endif
 #endif
 #ifdef INLINING
     int inlining = inlining_enabled && mb->name != SYMBOL(class_init);
@@ -83,43 +189,55 @@ void prepare(MethodBlock *mb, const void ***handlers) {
     unsigned char *code = mb->code;
     Instruction *new_code = NULL;
     short map[code_len];
+    int lock_idx = PREPARE_LOCK_INDEX(mb);
     int ins_count = 0;
+    Thread *self;
     int pass;
     int i;
 
     /* The method's state field indicates whether the method
        has been prepared.  The check in the interpreter is
-       unsynchronised, so grab the lock and recheck.  If
-       another thread tries to prepare the method, they will
-       wait on the lock.  This lock is global, but methods are
-       only prepared once, and contention to prepare a method
-       is unlikely. */
-
-    Thread *self = threadSelf();
+       unsynchronised, and another thread may have finished
+       preparing the method since, so check again.  Otherwise,
+       the thread which moves the state from unprepared to
+       preparing (with a compare-and-swap, so no lock is taken)
+       prepares the method.  Any other thread waits on the
+       method's prepare lock until it's prepared.  The locks are
+       striped by method, so a waiting thread is only woken by
+       the completion of methods sharing its lock. */
+
+    if(mb->state >= MB_PREPARED) {
+        MBARRIER();
+        return;
+    }
 
+    self = threadSelf();
     disableSuspend(self);
-    lockVMWaitLock(prepare_lock, self);
 
-retry:
-    switch(mb->state) {
-        case MB_UNPREPARED:
-            mb->state = MB_PREPARING;
-            break;
+    if(!__sync_bool_compare_and_swap(&mb->state, MB_UNPREPARED,
+                                     MB_PREPARING)) {
+        lockVMWaitLock(prepare_locks[lock_idx], self);
 
-        case MB_PREPARING:
-            waitVMWaitLock(prepare_lock, self);
-            goto retry;
+        while(mb->state == MB_PREPARING)
+            waitVMWaitLock(prepare_locks[lock_idx], self);
 
-        default:
-            unlockVMWaitLock(prepare_lock, self);
-            enableSuspend(self);
-            return;
+        unlockVMWaitLock(prepare_locks[lock_idx], self);
+        enableSuspend(self);
+        return;
     }
 
-    unlockVMWaitLock(prepare_lock, self);
-
     TRACE("Preparing %s.%s%s\n", CLASS_CB(mb->class)->name, mb->name, mb->type);
 
+#ifdef PREPARE_CACHE
+    /* Use the method's code from the prepared-code cache if
+       it's there.  Otherwise, the map is used to find the
+       bytecode of each instruction when saving the code */
+    if(prepareCacheLoad(mb, handlers, &new_code, &ins_count))
+        goto prepared;
+
+    memset(map, -1, sizeof(map));
+#endif
+
 #ifdef USE_CACHE
     /* Initialise cache depth array, indicating that
        the depth of every bytecode is unknown */
@@ -172,11 +290,16 @@ retry:
 #endif
                     map[pc] = ins_count;
             }
-#ifdef DIRECT_DEBUG
+#if defined(DIRECT_DEBUG) || defined(OPCODE_STATS)
             else {
                 new_code[ins_count].opcode = opcode;
+#ifdef DIRECT_DEBUG
                 new_code[ins_count].bytecode_pc = pc;
                 new_code[ins_count].cache_depth = cache;
+#endif
+#ifdef OPCODE_STATS
+                new_code[ins_count].count = 0;
+#endif
             }
 #endif
             /* For instructions without an operand */
@@ -601,17 +724,46 @@ retry:
                         i = npairs*2+2;
 #endif
                     } else {
-                        LookupTable *table = sysMalloc(sizeof(LookupTable));
-   
-                        table->num_entries = npairs;
-                        table->deflt = &new_code[map[pc + deflt]];
-                        table->entries = sysMalloc(npairs * sizeof(LookupEntry));
+                        Instruction *deflt_ins = &new_code[map[pc + deflt]];
+                        LookupEntry *entries = sysMalloc(npairs * sizeof(LookupEntry));
                             
                         for(i = 2, j = 0; j < npairs; i += 2, j++) {
-                            table->entries[j].key = ntohl(aligned_pc[i]);
-                            table->entries[j].handler = &new_code[map[pc + ntohl(aligned_pc[i+1])]];
+                            entries[j].key = ntohl(aligned_pc[i]);
+                            entries[j].handler = &new_code[map[pc + ntohl(aligned_pc[i+1])]];
+                        }
+
+                        qsort(entries, npairs, sizeof(LookupEntry), compareLookupEntries);
+
+                        if(isDenseLookupSwitch(entries, npairs)) {
+                            SwitchTable *table = sysMalloc(sizeof(SwitchTable));
+                            int size;
+
+                            table->low = entries[0].key;
+                            table->high = entries[npairs - 1].key;
+                            table->deflt = deflt_ins;
+
+                            size = table->high - table->low + 1;
+                            table->entries = sysMalloc(size * sizeof(Instruction *));
+
+                            for(j = 0; j < size; j++)
+                                table->entries[j] = deflt_ins;
+
+                            for(j = 0; j < npairs; j++)
+                                table->entries[entries[j].key - table->low] = entries[j].handler;
+
+                            sysFree(entries);
+
+                            opcode = OPC_TABLESWITCH;
+                            operand.pntr = table;
+                        } else {
+                            LookupTable *table = sysMalloc(sizeof(LookupTable));
+
+                            table->num_entries = npairs;
+                            table->deflt = deflt_ins;
+                            table->entries = entries;
+
+                            operand.pntr = table;
                         }
-                        operand.pntr = table;
                     }
 
                     pc = (unsigned char*)&aligned_pc[i] - code;
@@ -909,10 +1061,27 @@ retry:
                 /* Store the new instruction */
                 new_code[ins_count].handler = handlers[ins_cache][opcode];
                 new_code[ins_count].operand = operand;
+#if defined(USE_CACHE) && defined(SUPER_INSNS)
+                ins_depth[ins_count] = ins_cache;
+#endif
             }
         }
     }
 
+#ifdef SUPER_INSNS
+#ifdef INLINING
+    /* A superinstruction would bypass the profiling and inlined
+       code installed on the instructions it covers, so they're
+       only used for methods which aren't inlined */
+    if(!inlining)
+#endif
+#ifdef USE_CACHE
+        selectSuperInsns(new_code, ins_count, handlers, ins_depth);
+#else
+        selectSuperInsns(new_code, ins_count, handlers, NULL);
+#endif
+#endif
+
     /* Update the method's line number and exception tables
       with the new instruction offsets */
 
@@ -928,21 +1097,148 @@ retry:
         entry->handler_pc = map[entry->handler_pc];
     }
 
+#ifdef PREPARE_CACHE
+    prepareCacheSave(mb, new_code, ins_count, code, map, handlers);
+
+prepared:
+#endif
     /* Update the method with the new code, and
        mark the method as being prepared. */
 
     mb->code = new_code;
     mb->code_size = ins_count;
 
-    lockVMWaitLock(prepare_lock, self);
+    lockVMWaitLock(prepare_locks[lock_idx], self);
     mb->state = MB_PREPARED;
 
-    notifyAllVMWaitLock(prepare_lock, self);
-    unlockVMWaitLock(prepare_lock, self);
+    /* Invokes can now enter the method directly */
+    if(!(mb->access_flags & ACC_SYNCHRONIZED))
+        mb->entry = ENTRY_INTERPRETED;
+
+    notifyAllVMWaitLock(prepare_locks[lock_idx], self);
+    unlockVMWaitLock(prepare_locks[lock_idx], self);
     enableSuspend(self);
 
     /* We don't need the old bytecode stream anymore */
     if(!(mb->access_flags & (ACC_ABSTRACT | ACC_MIRANDA)))
         sysFree(code);
 }
+
+/* Inline caches for invokeinterface call sites.  All caches are kept
+   on a list so the GC can update the cached classes when the heap is
+   compacted, and remove unloaded classes (and the caches of unloaded
+   methods) */
+
+static pthread_mutex_t intf_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static InterfaceCache *intf_cache_list = NULL;
+
+InterfaceCache *newInterfaceCache(MethodBlock *owner, MethodBlock *imethod) {
+    InterfaceCache *cache = sysMalloc(sizeof(InterfaceCache));
+    Thread *self = threadSelf();
+
+    memset(cache, 0, sizeof(InterfaceCache));
+    cache->imethod = imethod;
+    cache->owner = owner;
+
+    /* The GC modifies the list with the world stopped, so
+       suspension must be disabled while adding to it */
+    fastDisableSuspend(self);
+    pthread_mutex_lock(&intf_cache_lock);
+
+    cache->next = intf_cache_list;
+    intf_cache_list = cache;
+
+    pthread_mutex_unlock(&intf_cache_lock);
+    fastEnableSuspend(self);
+
+    return cache;
+}
+
+/* Called on a cache miss.  Returns NULL if the class does not
+   implement the interface */
+
+MethodBlock *lookupInterfaceCache(InterfaceCache *cache, Class *class) {
+    ClassBlock *cb = CLASS_CB(class);
+    MethodBlock *imethod = cache->imethod;
+    int i = cache->imethod_table_hint;
+    Thread *self = threadSelf();
+    uintptr_t count;
+    MethodBlock *mb;
+    int mtbl_idx;
+
+    if(i >= cb->imethod_table_size ||
+              imethod->class != cb->imethod_table[i].interface) {
+        if((i = findIMethodTableIndex(cb, imethod->class)) == -1)
+            return NULL;
+
+        cache->imethod_table_hint = i;
+    }
+
+    mtbl_idx = cb->imethod_table[i].offsets[imethod->method_table_index];
+    mb = cb->method_table[mtbl_idx];
+
+    /* Add the class to the cache if there's a free entry.  The
+       entry is claimed by incrementing the count.  The class is
+       written after the method, so a thread checking the entry
+       never sees the class without the method.  The GC moves
+       entries when it reclaims those of unloaded classes, so the
+       thread must not be suspended with an entry half written */
+    fastDisableSuspend(self);
+
+    while((count = cache->count) < INTF_CACHE_SIZE)
+        if(LOCKWORD_COMPARE_AND_SWAP(&cache->count, count, count + 1)) {
+            cache->entries[count].mb = mb;
+            MBARRIER();
+            cache->entries[count].class = class;
+            break;
+        }
+
+    fastEnableSuspend(self);
+    return mb;
+}
+
+/* Called by the GC with the world stopped, before unmarked objects
+   are freed.  Entries for classes which are being unloaded are
+   removed, and the remaining entries moved down so the free entries
+   can be reused.  If the heap is being compacted, references to live
+   classes are then threaded (in their new place) */
+
+static void scanCaches(int compacting) {
+    InterfaceCache *cache, **prev = &intf_cache_list;
+
+    while((cache = *prev) != NULL) {
+        int i, j;
+
+        if(!isMarked(cache->owner->class)) {
+            *prev = cache->next;
+            gcPendingFree(cache);
+            continue;
+        }
+
+        for(i = j = 0; i < cache->count; i++)
+            if(isMarked(cache->entries[i].class))
+                cache->entries[j++] = cache->entries[i];
+
+        for(i = j; i < cache->count; i++) {
+            cache->entries[i].class = NULL;
+            cache->entries[i].mb = NULL;
+        }
+
+        cache->count = j;
+
+        if(compacting)
+            for(i = 0; i < j; i++)
+                threadReference((Object**)&cache->entries[i].class);
+
+        prev = &cache->next;
+    }
+}
+
+void scanInterfaceCaches() {
+    scanCaches(FALSE);
+}
+
+void threadInterfaceCaches() {
+    scanCaches(TRUE);
+}
 #endif
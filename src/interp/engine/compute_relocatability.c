@@ -28,6 +28,13 @@ int handler_sizes[HANDLERS][LABELS_SIZE];
 int inlining_inited = FALSE;
 int goto_len;
 
+#ifdef OPCODE_STATS
+/* executeJava is only called to get the handler tables */
+OpcodeStats *opcodeStats() {
+    return NULL;
+}
+#endif
+
 char *value2Str(int value, char *buff) {
     switch(value) {
         case MEMCMP_FAILED:
@@ -176,6 +183,10 @@ FieldBlock *resolveField(Class *class, int index) {
     return NULL;
 }
 
+int isTrivialMethod(MethodBlock *mb) {
+    return FALSE;
+}
+
 uintptr_t resolveSingleConstant(Class *class, int index) {
     return 0;
 }
@@ -206,6 +217,24 @@ ExecEnv *getExecEnv() {
     return NULL;
 }
 
+int growJavaStack(ExecEnv *ee, char *sp) {
+    return FALSE;
+}
+
+void useStackRedZone(ExecEnv *ee) {
+}
+
+void releaseStackRedZone(ExecEnv *ee) {
+}
+
+InterfaceCache *newInterfaceCache(MethodBlock *owner, MethodBlock *imethod) {
+    return NULL;
+}
+
+MethodBlock *lookupInterfaceCache(InterfaceCache *cache, Class *class) {
+    return NULL;
+}
+
 void exitVM(int status) {
 }
 
@@ -18,6 +18,29 @@
  * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+/* Static superinstructions (generated into superinsns.h by
+   src/tools/gen-superinsns.c) are selected by prepare.  They're
+   not used when collecting opcode statistics, as a superinstruction
+   hides the opcodes it executes */
+#ifndef OPCODE_STATS
+#define SUPER_INSNS
+#include "superinsns.h"
+
+extern int superInsnFirstOpcode(int opcode);
+#endif
+
+/* A superinstruction runs its opcodes on the operand stack.  With
+   stack-caching, the cache is flushed on entry and refilled to the
+   depth of the next instruction (given for each entry depth) */
+#ifdef USE_CACHE
+#define CACHE_FILL_0
+#define CACHE_FILL_1                          \
+    cache.i.v1 = *--ostack;
+#define CACHE_FILL_2                          \
+    cache.i.v2 = *--ostack;                   \
+    cache.i.v1 = *--ostack;
+#endif
+
 #define PREPARE_MB(mb)                        \
     if(mb->state < MB_PREPARED)               \
         prepare(mb, handlers)
@@ -67,5 +90,6 @@
 #define RESOLVED_METHOD(pc)       ((MethodBlock*)pc->operand.pntr)
 #define RESOLVED_POLYMETHOD(pc)   ((PolyMethodBlock*)pc->operand.pntr)
 #define RESOLVED_INVDYNMETHOD(pc) ((InvDynMethodBlock*)pc->operand.pntr)
+#define RESOLVED_INTF_CACHE(pc)   ((InterfaceCache*)pc->operand.pntr)
 #define RESOLVED_CLASS(pc)        (Class *)CP_INFO(cp, pc->operand.uui.u1)
 #define INTRINSIC_ARGS(pc)        pc->operand.i
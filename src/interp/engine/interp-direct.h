@@ -30,11 +30,13 @@
 #define INTERPRETER_DEFINITIONS                            \
     DEFINE_HANDLER_TABLES                                  \
     const void *next_handler;                              \
-    static const void **handlers[] = {HNDLR_TBLS(ENTRY)};
+    static const void **handlers[] = {HNDLR_TBLS(ENTRY)};  \
+    int oob_array_index = 0;
 #else
 #define INTERPRETER_DEFINITIONS                            \
     DEFINE_HANDLER_TABLES                                  \
-    static const void **handlers[] = {HNDLR_TBLS(ENTRY)};
+    static const void **handlers[] = {HNDLR_TBLS(ENTRY)};  \
+    int oob_array_index = 0;
 #endif
 
 #define INTERPRETER_PROLOGUE                               \
@@ -46,6 +48,20 @@ rewrite_lock:                                              \
 #define D(opcode, level, label) &&unused
 #define X(opcode, level, label) L(opcode, level, label)
 
+/* The wide field access handlers are used for large field offsets
+   with implicit null checks (see interp.h) */
+#ifdef IMPLICIT_NULL_CHECKS
+#define W(opcode, level, label) L(opcode, level, label)
+#else
+#define W(opcode, level, label) &&unused
+#endif
+
+#ifdef SUPER_INSNS
+#define S(opcode, level, label) L(opcode, level, label)
+#else
+#define S(opcode, level, label) &&unused
+#endif
+
 #define DEF_HANDLER_TABLES(level)                          \
     DEF_HANDLER_TABLE(level, ENTRY);
 
@@ -188,6 +204,25 @@ opc##x##_##y##_##z:
     label(op2, 0, ENTRY)                        \
         BODY
 
+#define DEF_SUPER_OPC(opcode, exit0, exit1, exit2, BODY) \
+    label(opcode, 2, ENTRY)                     \
+        *ostack++ = cache.i.v1;                 \
+        *ostack++ = cache.i.v2;                 \
+        BODY                                    \
+        CACHE_FILL_##exit2                      \
+        DISPATCH_FIRST                          \
+                                                \
+    label(opcode, 1, ENTRY)                     \
+        *ostack++ = cache.i.v1;                 \
+        BODY                                    \
+        CACHE_FILL_##exit1                      \
+        DISPATCH_FIRST                          \
+                                                \
+    label(opcode, 0, ENTRY)                     \
+        BODY                                    \
+        CACHE_FILL_##exit0                      \
+        DISPATCH_FIRST
+
 #define LABELS(opcode)                          \
     label(opcode, 0, ENTRY)                     \
     label(opcode, 1, ENTRY)                     \
@@ -228,6 +263,12 @@ opc##x##_##y##_##z:
 #define DEF_OPC_210_2(op1, op2, BODY)           \
     DEF_OPC_012_2(op1, op2, ({BODY});)
 
+#define DEF_SUPER_OPC(opcode, exit0, exit1, exit2, BODY) \
+    DEF_OPC(opcode, 0,                          \
+        BODY                                    \
+        DISPATCH_FIRST                          \
+    )
+
 #define DEF_OPC_RW(opcode, BODY)                \
     DEF_OPC_012(opcode, ({BODY});)
 
@@ -236,10 +277,22 @@ opc##x##_##y##_##z:
 
 #endif /* USE_CACHE */
 
+/* Executions are counted as each instruction is dispatched */
+#ifdef OPCODE_STATS
+#define COUNT_DISPATCH                          \
+{                                               \
+    pc->count++;                                \
+    COUNT_OPCODE(pc->opcode)                    \
+}
+#else
+#define COUNT_DISPATCH
+#endif
+
 #ifdef PREFETCH
 #define DISPATCH_FIRST                          \
 {                                               \
     next_handler = pc[1].handler;               \
+    COUNT_DISPATCH                              \
     REDISPATCH                                  \
 }
 
@@ -247,14 +300,30 @@ opc##x##_##y##_##z:
 {                                               \
     const void *dispatch = next_handler;        \
     next_handler = (++pc)[1].handler;           \
+    COUNT_DISPATCH                              \
     goto *dispatch;                             \
 }
 #else
+#ifdef OPCODE_STATS
+#define DISPATCH_FIRST                          \
+{                                               \
+    COUNT_DISPATCH                              \
+    REDISPATCH                                  \
+}
+
+#define DISPATCH(level, ins_len)                \
+{                                               \
+    pc++;                                       \
+    COUNT_DISPATCH                              \
+    REDISPATCH                                  \
+}
+#else
 #define DISPATCH_FIRST                          \
     REDISPATCH
 
 #define DISPATCH(level, ins_len)                \
     goto *(++pc)->handler;
+#endif
 
 #endif /* PREFETCH */
 
@@ -287,23 +356,23 @@ opc##x##_##y##_##z:
     goto throwException;                                                   \
 }
 
+/* The exceptions are thrown out of line (see throwNull, etc. in
+   interp.c), so a check is only a compare and a branch which is
+   predicted not-taken, keeping the handlers small */
+
 #define NULL_POINTER_CHECK(ref)                                            \
-    if(!ref) THROW_EXCEPTION(java_lang_NullPointerException, NULL);
+    if(__builtin_expect(!ref, FALSE)) goto throwNull;
 
 #define MAX_INT_DIGITS 11
 
 #define ARRAY_BOUNDS_CHECK(array, idx)                                     \
-{                                                                          \
-    if(idx >= ARRAY_LEN(array)) {                                          \
-        char buff[MAX_INT_DIGITS];                                         \
-        snprintf(buff, MAX_INT_DIGITS, "%d", idx);                         \
-        THROW_EXCEPTION(java_lang_ArrayIndexOutOfBoundsException, buff);   \
-    }                                                                      \
-}
+    if(__builtin_expect(idx >= ARRAY_LEN(array), FALSE)) {                 \
+        oob_array_index = idx;                                             \
+        goto throwOOB;                                                     \
+    }
 
 #define ZERO_DIVISOR_CHECK(value)                                          \
-    if(value == 0)                                                         \
-        THROW_EXCEPTION(java_lang_ArithmeticException, "division by zero");
+    if(__builtin_expect(value == 0, FALSE)) goto throwArithmeticExcep;
 
 
 extern void initialiseDirect(InitArgs *args);
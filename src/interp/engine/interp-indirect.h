@@ -23,7 +23,8 @@
 #include "interp-threading.h"
 
 #define INTERPRETER_DEFINITIONS                            \
-    DEFINE_HANDLER_TABLES
+    DEFINE_HANDLER_TABLES                                  \
+    int oob_array_index = 0;
 
 #define DISPATCH_PROLOGUE                                  \
     DISPATCH_FIRST                                         \
@@ -31,7 +32,9 @@ unused:
 
 #define I(opcode, level, label) &&unused
 #define D(opcode, level, label) L(opcode, level, label)
+#define W(opcode, level, label) L(opcode, level, label)
 #define X(opcode, level, label) L(opcode, level, label)
+#define S(opcode, level, label) &&unused
 
 #define DEF_HANDLER_TABLES(level)                          \
     DEF_HANDLER_TABLE(level, ENTRY);
@@ -39,7 +42,7 @@ unused:
 #else /* THREADED */
 
 #define INTERPRETER_DEFINITIONS                            \
-    /* none */
+    int oob_array_index = 0;
 
 #define DISPATCH_PROLOGUE                                  \
     while(TRUE) {                                          \
@@ -106,6 +109,7 @@ opc##x##_##y##_##z:
 #define DISPATCH(level, ins_len)                \
 {                                               \
     pc += ins_len;                              \
+    COUNT_OPCODE(*pc)                           \
     goto *handlers_##level##_ENTRY[*pc];        \
 }
 
@@ -117,6 +121,7 @@ opc##x##_##y##_##z:
 #define DISPATCH(level, ins_len)                \
 {                                               \
     pc += ins_len;                              \
+    COUNT_OPCODE(*pc)                           \
     break;                                      \
 }
 #endif
@@ -315,21 +320,21 @@ opc##x##_##y##_##z:
     goto throwException;                                                   \
 }
 
+/* The exceptions are thrown out of line (see throwNull, etc. in
+   interp.c), so a check is only a compare and a branch which is
+   predicted not-taken, keeping the handlers small */
+
 #define NULL_POINTER_CHECK(ref)                                            \
-    if(!ref) THROW_EXCEPTION(java_lang_NullPointerException, NULL);
+    if(__builtin_expect(!ref, FALSE)) goto throwNull;
 
 #define MAX_INT_DIGITS 11
 
 #define ARRAY_BOUNDS_CHECK(array, idx)                                     \
-{                                                                          \
-    if(idx >= ARRAY_LEN(array)) {                                          \
-        char buff[MAX_INT_DIGITS];                                         \
-        snprintf(buff, MAX_INT_DIGITS, "%d", idx);                         \
-        THROW_EXCEPTION(java_lang_ArrayIndexOutOfBoundsException, buff);   \
-    }                                                                      \
-}
+    if(__builtin_expect(idx >= ARRAY_LEN(array), FALSE)) {                 \
+        oob_array_index = idx;                                             \
+        goto throwOOB;                                                     \
+    }
 
 #define ZERO_DIVISOR_CHECK(value)                                          \
-    if(value == 0)                                                         \
-        THROW_EXCEPTION(java_lang_ArithmeticException, "division by zero");
+    if(__builtin_expect(value == 0, FALSE)) goto throwArithmeticExcep;
 
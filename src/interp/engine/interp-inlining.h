@@ -102,8 +102,15 @@ unused:                                                               \
 
 #define I(opcode, level, label) L(opcode, level, label)
 #define D(opcode, level, label) &&rewrite_lock
+#define W(opcode, level, label) &&rewrite_lock
 #define X(opcode, level, label) &&rewrite_lock
 
+#ifdef SUPER_INSNS
+#define S(opcode, level, label) L(opcode, level, label)
+#else
+#define S(opcode, level, label) &&unused
+#endif
+
 #define DEF_HANDLER_TABLES(level)    \
     DEF_HANDLER_TABLE(level, START); \
     DEF_HANDLER_TABLE(level, ENTRY); \
@@ -201,10 +208,23 @@ opc##x##_##y##_##z##:
 opc##x##_##y##_##z:
 #endif
 
+/* Executions are counted within the handler body, so
+   they are also counted when the handler is inlined */
+#ifdef OPCODE_STATS
+#define COUNT_HANDLER(opcode)                   \
+{                                               \
+    pc->count++;                                \
+    COUNT_OPCODE(opcode)                        \
+}
+#else
+#define COUNT_HANDLER(opcode)
+#endif
+
 #define DEF_OPC_LBLS(opcode, level, PRE, BODY)  \
     label(opcode, level, START)                 \
         PAD                                     \
     label(opcode, level, ENTRY)                 \
+        COUNT_HANDLER(opcode)                   \
         PRE                                     \
     GUARD(opcode, level)                        \
         BODY                                    \
@@ -281,6 +301,25 @@ opc##x##_##y##_##z:
     });)                                        \
                                                 \
     DEF_OPC(opcode, 0, ({BODY});)
+
+#define DEF_SUPER_OPC(opcode, exit0, exit1, exit2, BODY) \
+    DEF_OPC(opcode, 2, ({                       \
+        *ostack++ = cache.i.v1;                 \
+        *ostack++ = cache.i.v2;                 \
+        BODY                                    \
+        CACHE_FILL_##exit2                      \
+    });)                                        \
+                                                \
+    DEF_OPC(opcode, 1, ({                       \
+        *ostack++ = cache.i.v1;                 \
+        BODY                                    \
+        CACHE_FILL_##exit1                      \
+    });)                                        \
+                                                \
+    DEF_OPC(opcode, 0, ({                       \
+        BODY                                    \
+        CACHE_FILL_##exit0                      \
+    });)
         
 #define DEF_OPC_GRD(opcode, level, PRE, BODY)   \
     DEF_OPC_LBLS(opcode, level, PRE, BODY)      \
@@ -334,6 +373,9 @@ opc##x##_##y##_##z:
 #define DEF_OPC_210(opcode, BODY)               \
     DEF_OPC(opcode, 0, BODY)
 
+#define DEF_SUPER_OPC(opcode, exit0, exit1, exit2, BODY) \
+    DEF_OPC(opcode, 0, BODY)
+
 #define DEF_OPC_FLOAT(opcode, BODY)             \
     DEF_OPC(opcode, 0, BODY)
 
@@ -253,10 +253,10 @@
         X(OPC_IFNONNULL,              level, label), \
         D(OPC_GOTO_W,                 level, label), \
         D(OPC_JSR_W,                  level, label), \
-        &&unused,                                    \
+        S(OPC_SUPER_0,                level, label), \
         L(OPC_LDC_QUICK,              level, label), \
         L(OPC_LDC_W_QUICK,            level, label), \
-        &&unused,                                    \
+        S(OPC_SUPER_1,                level, label), \
         L(OPC_GETFIELD_QUICK,         level, label), \
         L(OPC_PUTFIELD_QUICK,         level, label), \
         L(OPC_GETFIELD2_QUICK,        level, label), \
@@ -278,22 +278,22 @@
         I(OPC_INLINE_REWRITER,        level, label), \
         I(OPC_PROFILE_REWRITER,       level, label), \
         D(OPC_INVOKEVIRTUAL_QUICK_W,  level, label), \
-        D(OPC_GETFIELD_QUICK_W,       level, label), \
-        D(OPC_PUTFIELD_QUICK_W,       level, label), \
+        W(OPC_GETFIELD_QUICK_W,       level, label), \
+        W(OPC_PUTFIELD_QUICK_W,       level, label), \
         L(OPC_GETFIELD_THIS,          level, label), \
         D(OPC_LOCK,                   level, label), \
         L(OPC_ALOAD_THIS,             level, label), \
         L(OPC_INVOKESTATIC_QUICK,     level, label), \
         L(OPC_NEW_QUICK,              level, label), \
-        &&unused,                                    \
+        S(OPC_SUPER_2,                level, label), \
         L(OPC_ANEWARRAY_QUICK,        level, label), \
-        &&unused,                                    \
-        &&unused,                                    \
+        S(OPC_SUPER_3,                level, label), \
+        S(OPC_SUPER_4,                level, label), \
         L(OPC_CHECKCAST_QUICK,        level, label), \
         L(OPC_INSTANCEOF_QUICK,       level, label), \
-        &&unused,                                    \
-        &&unused,                                    \
-        &&unused,                                    \
+        S(OPC_SUPER_5,                level, label), \
+        S(OPC_SUPER_6,                level, label), \
+        S(OPC_SUPER_7,                level, label), \
         L(OPC_MULTIANEWARRAY_QUICK,   level, label), \
         J(OPC_INVOKEHANDLE,           level, label), \
         J(OPC_INVOKEBASIC,            level, label), \
@@ -302,9 +302,9 @@
         J(OPC_LINKTOINTERFACE,        level, label), \
         L(OPC_INVOKEINTERFACE_QUICK,  level, label), \
         J(OPC_INVOKEDYNAMIC_QUICK,    level, label), \
-        &&unused,                                    \
-        &&unused,                                    \
-        &&unused,                                    \
-        &&unused,                                    \
-        &&unused};
+        L(OPC_INVOKEVIRTUAL_TRIVIAL,  level, label), \
+        L(OPC_INVOKENONVIRT_TRIVIAL,  level, label), \
+        L(OPC_INVOKESTATIC_TRIVIAL,   level, label), \
+        S(OPC_SUPER_8,                level, label), \
+        S(OPC_SUPER_9,                level, label)};
 
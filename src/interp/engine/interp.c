@@ -39,8 +39,19 @@
 #include "class.h"
 #include "classlib.h"
 
+/* With implicit checks the interpreter is placed in its own section,
+   so the SIGSEGV handler can tell if a fault is within it */
+#ifdef IMPLICIT_CHECKS
+__attribute__ ((section ("jam_interp")))
+#endif
 uintptr_t *executeJava() {
 
+    /* Opcode statistics, if built in */
+    OPCODE_STATS_DEFINITIONS
+
+    /* The return point for implicit checks, if enabled */
+    IMPLICIT_CHECK_DEFINITIONS
+
     /* Definitions specific to the particular
        interpreter variant */
     INTERPRETER_DEFINITIONS
@@ -63,16 +74,29 @@ uintptr_t *executeJava() {
     uintptr_t *arg1;
     register CodePntr pc;
     ExecEnv *ee = getExecEnv();
-    Frame *frame = ee->last_frame;
-    register uintptr_t *lvars = frame->lvars;
-    register uintptr_t *ostack = frame->ostack;
+    Frame *frame;
+    register uintptr_t *lvars;
+    register uintptr_t *ostack;
 
-    Object *this = (Object*)lvars[0];
-    MethodBlock *new_mb, *mb = frame->mb;
-    ConstantPool *cp = &(CLASS_CB(mb->class)->constant_pool);
+    Object *this;
+    MethodBlock *new_mb, *mb;
+    ConstantPool *cp;
 
     CACHED_POLY_OFFSETS
 
+    /* Set the return point for a fault (if implicit checks are
+       enabled).  This is done before the state is initialised, so
+       it isn't live across the sigsetjmp, which would stop it being
+       held in registers */
+    IMPLICIT_CHECK_ENTRY
+
+    frame = ee->last_frame;
+    lvars = frame->lvars;
+    ostack = frame->ostack;
+    this = (Object*)lvars[0];
+    mb = frame->mb;
+    cp = &(CLASS_CB(mb->class)->constant_pool);
+
     /* Initialise pc to the start of the method.  If it
        hasn't been executed before it may need preparing */
     PREPARE_MB(mb);
@@ -436,21 +460,21 @@ uintptr_t *executeJava() {
 #define GETFIELD_QUICK_0(offset, type)                     \
 {                                                          \
     Object *obj = (Object *)*--ostack;                     \
-    NULL_POINTER_CHECK(obj);                               \
+    DEREF_NULL_CHECK(obj);                                 \
     PUSH_0(INST_DATA(obj, type, offset), 3);               \
 }
 
 #define GETFIELD_QUICK_1(offset, type)                     \
 {                                                          \
     Object *obj = (Object *)cache.i.v1;                    \
-    NULL_POINTER_CHECK(obj);                               \
+    DEREF_NULL_CHECK(obj);                                 \
     PUSH_0(INST_DATA(obj, type, offset), 3);               \
 }
 
 #define GETFIELD_QUICK_2(offset, type)                     \
 {                                                          \
     Object *obj = (Object *)cache.i.v2;                    \
-    NULL_POINTER_CHECK(obj);                               \
+    DEREF_NULL_CHECK(obj);                                 \
     PUSH_1(INST_DATA(obj, type, offset), 3);               \
 }
 
@@ -548,6 +572,10 @@ uintptr_t *executeJava() {
     MULTI_LEVEL_OPCODES(2);
 #endif
 
+#ifdef SUPER_INSNS
+    SUPER_INSN_HANDLERS
+#endif
+
     DEF_OPC_210(OPC_NOP,
         DISPATCH(0, 1);
     )
@@ -663,7 +691,7 @@ uintptr_t *executeJava() {
     int idx = ARRAY_LOAD_IDX;                  \
     Object *array = (Object *)ARRAY_LOAD_ARY;  \
                                                \
-    NULL_POINTER_CHECK(array);                 \
+    DEREF_NULL_CHECK(array);                   \
     ARRAY_BOUNDS_CHECK(array, idx);            \
     PUSH_0(ARRAY_DATA(array, TYPE)[idx], 1);   \
 }
@@ -696,7 +724,7 @@ uintptr_t *executeJava() {
         int idx = ARRAY_LOAD_IDX;
         Object *array = (Object *)ARRAY_LOAD_ARY;
 
-        NULL_POINTER_CHECK(array);
+        DEREF_NULL_CHECK(array);
         ARRAY_BOUNDS_CHECK(array, idx);
         PUSH_LONG(ARRAY_DATA(array, u8)[idx], 1);
     })
@@ -715,7 +743,7 @@ uintptr_t *executeJava() {
     int idx = ARRAY_STORE_IDX;                \
     Object *array = (Object *)*--ostack;      \
                                               \
-    NULL_POINTER_CHECK(array);                \
+    DEREF_NULL_CHECK(array);                  \
     ARRAY_BOUNDS_CHECK(array, idx);           \
     ARRAY_DATA(array, TYPE)[idx] = val;       \
     DISPATCH(0, 1);                           \
@@ -742,7 +770,7 @@ uintptr_t *executeJava() {
         int idx = ARRAY_STORE_IDX;
         Object *array = (Object *)*--ostack;
 
-        NULL_POINTER_CHECK(array);
+        DEREF_NULL_CHECK(array);
         ARRAY_BOUNDS_CHECK(array, idx);
 
         if((obj != NULL) && !arrayStoreCheck(array->class, obj->class))
@@ -760,7 +788,7 @@ uintptr_t *executeJava() {
         Object *array = (Object *)ostack[-2];
 
         ostack -= 2;
-        NULL_POINTER_CHECK(array);
+        DEREF_NULL_CHECK(array);
         ARRAY_BOUNDS_CHECK(array, idx);
 
         ARRAY_DATA(array, u8)[idx] = cache.l;
@@ -774,7 +802,7 @@ uintptr_t *executeJava() {
         Object *array = (Object *)ostack[-4];
 
         ostack -= 4;
-        NULL_POINTER_CHECK(array);
+        DEREF_NULL_CHECK(array);
         ARRAY_BOUNDS_CHECK(array, idx);
 
         ARRAY_DATA(array, u8)[idx] = *(u8*)&ostack[2];
@@ -1233,7 +1261,7 @@ uintptr_t *executeJava() {
     DEF_OPC_210(OPC_ARRAYLENGTH, {
         Object *array = (Object *)*--ostack;
 
-        NULL_POINTER_CHECK(array);
+        DEREF_NULL_CHECK(array);
         PUSH_0(ARRAY_LEN(array), 1);
     })
 
@@ -1261,6 +1289,7 @@ uintptr_t *executeJava() {
     DEF_OPC_210(OPC_MONITORENTER, {
         Object *obj = (Object *)*--ostack;
         NULL_POINTER_CHECK(obj);
+        frame->last_pc = pc;
         objectLock(obj);
         DISPATCH(0, 1);
     })
@@ -1310,14 +1339,27 @@ uintptr_t *executeJava() {
 
     DEF_OPC_210(OPC_LOOKUPSWITCH, {
         LookupTable *table = (LookupTable*)pc->operand.pntr;
+        LookupEntry *entries = table->entries;
+        int high = table->num_entries - 1;
         int key = *--ostack;
-        int i;
+        int low = 0;
+
+        /* The entries are sorted by key (see prepare) */
+        pc = table->deflt;
 
-        for(i = 0; (i < table->num_entries) &&
-                   (key != table->entries[i].key); i++);
+        while(low <= high) {
+            int mid = (low + high) >> 1;
+
+            if(key < entries[mid].key)
+                high = mid - 1;
+            else if(key > entries[mid].key)
+                low = mid + 1;
+            else {
+                pc = entries[mid].handler;
+                break;
+            }
+        }
 
-        pc = (i == table->num_entries ? table->deflt
-                                      : table->entries[i].handler);
         DISPATCH_SWITCH
     })
 
@@ -1403,6 +1445,16 @@ uintptr_t *executeJava() {
                 opcode = OPC_GETFIELD_QUICK;
 
         operand.i = fb->u.offset;
+
+#ifdef IMPLICIT_NULL_CHECKS
+        /* A null dereference at a large offset may not fault, so
+           the field is accessed by the handler which tests it */
+        if(fb->u.offset >= IMPLICIT_NULL_LIMIT) {
+            opcode = OPC_GETFIELD_QUICK_W;
+            operand.pntr = fb;
+        }
+#endif
+
         OPCODE_REWRITE(opcode, cache, operand);
 
         REDISPATCH
@@ -1430,6 +1482,16 @@ uintptr_t *executeJava() {
                 opcode = OPC_PUTFIELD_QUICK;
 
         operand.i = fb->u.offset;
+
+#ifdef IMPLICIT_NULL_CHECKS
+        /* A null dereference at a large offset may not fault, so
+           the field is accessed by the handler which tests it */
+        if(fb->u.offset >= IMPLICIT_NULL_LIMIT) {
+            opcode = OPC_PUTFIELD_QUICK_W;
+            operand.pntr = fb;
+        }
+#endif
+
         OPCODE_REWRITE(opcode, cache, operand);
 
         REDISPATCH
@@ -1466,7 +1528,22 @@ uintptr_t *executeJava() {
                 OPCODE_REWRITE(OPC_INVOKEBASIC, cache, operand);
             } else {
                 operand.pntr = new_mb;
-                OPCODE_REWRITE(OPC_INVOKENONVIRTUAL_QUICK, cache, operand);
+                OPCODE_REWRITE(isTrivialMethod(new_mb) ?
+                                   OPC_INVOKENONVIRT_TRIVIAL :
+                                   OPC_INVOKENONVIRTUAL_QUICK,
+                               cache, operand);
+            }
+        } else if(isTrivialMethod(new_mb)) {
+            /* A final method can't be overridden, so the call
+               doesn't need to check the receiver's method */
+            if(new_mb->access_flags & ACC_FINAL ||
+                    CLASS_CB(new_mb->class)->access_flags & ACC_FINAL) {
+                operand.pntr = new_mb;
+                OPCODE_REWRITE(OPC_INVOKENONVIRT_TRIVIAL, cache, operand);
+            } else {
+                operand.uu.u1 = new_mb->args_count;
+                operand.uu.u2 = new_mb->method_table_index;
+                OPCODE_REWRITE(OPC_INVOKEVIRTUAL_TRIVIAL, cache, operand);
             }
         } else {
             operand.uu.u1 = new_mb->args_count;
@@ -1498,7 +1575,10 @@ uintptr_t *executeJava() {
             OPCODE_REWRITE(OPC_INVOKESUPER_QUICK, cache, operand);
         } else {
             operand.pntr = new_mb;
-            OPCODE_REWRITE(OPC_INVOKENONVIRTUAL_QUICK, cache, operand);
+            OPCODE_REWRITE(isTrivialMethod(new_mb) ?
+                               OPC_INVOKENONVIRT_TRIVIAL :
+                               OPC_INVOKENONVIRTUAL_QUICK,
+                           cache, operand);
         }
 
         REDISPATCH
@@ -1531,13 +1611,21 @@ uintptr_t *executeJava() {
             operand.i = new_mb->args_count;
             OPCODE_REWRITE(opcode, cache, operand);
         } else {
+            /* The call can only be performed inline once the class
+               is initialised, as other threads must wait for this */
+            int trivial = CLASS_CB(new_mb->class)->state == CLASS_INITED
+                              && isTrivialMethod(new_mb);
+
             operand.pntr = new_mb;
-            OPCODE_REWRITE(OPC_INVOKESTATIC_QUICK, cache, operand);
+            OPCODE_REWRITE(trivial ? OPC_INVOKESTATIC_TRIVIAL :
+                                     OPC_INVOKESTATIC_QUICK,
+                           cache, operand);
         }
         REDISPATCH
     });)
 
     DEF_OPC_RW(OPC_INVOKEINTERFACE, ({
+        const void *handler = pc->handler;
         int idx, cache;
         Operand operand;
 
@@ -1550,8 +1638,15 @@ uintptr_t *executeJava() {
             goto throwException;
 
         if(CLASS_CB(new_mb->class)->access_flags & ACC_INTERFACE) {
-            operand.uu.u1 = idx;
-            operand.uu.u2 = 0;
+            /* Several threads may be quickening the site.  Only the
+               thread which claims the instruction creates the cache,
+               the others redispatch once it has been rewritten */
+            if(!LOCKWORD_COMPARE_AND_SWAP((uintptr_t*)&pc->handler,
+                                          (uintptr_t)handler,
+                                          (uintptr_t)&&rewrite_lock))
+                REDISPATCH
+
+            operand.pntr = newInterfaceCache(mb, new_mb);
             OPCODE_REWRITE(OPC_INVOKEINTERFACE_QUICK, cache, operand);
         } else {
             operand.uu.u1 = new_mb->args_count;
@@ -1676,14 +1771,28 @@ uintptr_t *executeJava() {
 
     DEF_OPC_210(OPC_LOOKUPSWITCH, {
         int *aligned_pc = (int*)((uintptr_t)(pc + 4) & ~0x3);
-        int deflt  = ntohl(aligned_pc[0]);
-        int npairs = ntohl(aligned_pc[1]);
+        int offset = ntohl(aligned_pc[0]);
+        int high   = ntohl(aligned_pc[1]) - 1;
         int key    = *--ostack;
-        int i;
-
-        for(i = 2; (i < npairs*2+2) && (key != ntohl(aligned_pc[i])); i += 2);
+        int low    = 0;
+
+        /* The class file format requires the match-offset
+           pairs to be sorted by key */
+        while(low <= high) {
+            int mid = (low + high) >> 1;
+            int match = ntohl(aligned_pc[mid*2+2]);
+
+            if(key < match)
+                high = mid - 1;
+            else if(key > match)
+                low = mid + 1;
+            else {
+                offset = ntohl(aligned_pc[mid*2+3]);
+                break;
+            }
+        }
 
-        DISPATCH(0, i == npairs*2+2 ? deflt : ntohl(aligned_pc[i+1]));
+        DISPATCH(0, offset);
     })
 
     DEF_OPC_210(OPC_GETSTATIC, {
@@ -1800,69 +1909,6 @@ uintptr_t *executeJava() {
         DISPATCH(0, 0);
     })
 
-    DEF_OPC_210(OPC_GETFIELD_QUICK_W, {
-        FieldBlock *fb = RESOLVED_FIELD(pc);
-        Object *obj = (Object *)*--ostack;
-
-        NULL_POINTER_CHECK(obj);
-
-        if((*fb->type == 'J') || (*fb->type == 'D')) {
-            PUSH_LONG(INST_DATA(obj, u8, fb->u.offset), 3);
-        } else {
-            if(*fb->type == 'L' || *fb->type == '[') {
-                PUSH_0(INST_DATA(obj, uintptr_t, fb->u.offset), 3);
-            } else {
-                PUSH_0(INST_DATA(obj, u4, fb->u.offset), 3);
-            }
-        }
-    })
-
-#ifdef USE_CACHE
-    DEF_OPC_012(OPC_PUTFIELD_QUICK_W, {
-        FieldBlock *fb = RESOLVED_FIELD(pc);
- 
-        if((*fb->type == 'J') || (*fb->type == 'D')) {
-            Object *obj = (Object *)*--ostack;
-
-            NULL_POINTER_CHECK(obj);
-            INST_DATA(obj, u8, fb->u.offset) = cache.l;
-        } else {
-            Object *obj = (Object *)cache.i.v1;
-
-            NULL_POINTER_CHECK(obj);
-
-            if(*fb->type == 'L' || *fb->type == '[')
-                INST_DATA(obj, uintptr_t, fb->u.offset) = cache.i.v2;
-            else
-                INST_DATA(obj, u4, fb->u.offset) = cache.i.v2;
-        }
-        DISPATCH(0, 3);
-    })
-#else
-    DEF_OPC_012(OPC_PUTFIELD_QUICK_W, {
-        FieldBlock *fb = RESOLVED_FIELD(pc);
- 
-        if((*fb->type == 'J') || (*fb->type == 'D')) {
-            Object *obj = (Object *)ostack[-3];
-
-            ostack -= 3;
-            NULL_POINTER_CHECK(obj);
-            INST_DATA(obj, u8, fb->u.offset) = *(u8*)&ostack[1];
-        } else {
-            Object *obj = (Object *)ostack[-2];
-
-            ostack -= 2;
-            NULL_POINTER_CHECK(obj);
-
-            if(*fb->type == 'L' || *fb->type == '[')
-                INST_DATA(obj, uintptr_t, fb->u.offset) = ostack[1];
-            else
-                INST_DATA(obj, u4, fb->u.offset) = ostack[1];
-        }
-        DISPATCH(0, 3);
-    })
-#endif
-
     DEF_OPC_210(OPC_INVOKEVIRTUAL, {
         int idx;
         WITH_OPCODE_CHANGE_CP_DINDEX(OPC_INVOKEVIRTUAL, idx);
@@ -1907,7 +1953,7 @@ uintptr_t *executeJava() {
 
         new_mb = RESOLVED_METHOD(pc);
         arg1 = ostack - new_mb->args_count;
-        NULL_POINTER_CHECK(*arg1);
+        DEREF_NULL_CHECK(*arg1);
 
         new_class = (*(Object **)arg1)->class;
         new_mb = CLASS_CB(new_class)->method_table[new_mb->method_table_index];
@@ -2102,6 +2148,75 @@ uintptr_t *executeJava() {
     })
 #endif /* DIRECT */
 
+/* With implicit null checks, the direct interpreter also uses the _W
+   field handlers, for field offsets too large to be certain that a
+   null dereference faults (see DEREF_NULL_CHECK) */
+
+#if !defined(DIRECT) || defined(IMPLICIT_NULL_CHECKS)
+    DEF_OPC_210(OPC_GETFIELD_QUICK_W, {
+        FieldBlock *fb = RESOLVED_FIELD(pc);
+        Object *obj = (Object *)*--ostack;
+
+        NULL_POINTER_CHECK(obj);
+
+        if((*fb->type == 'J') || (*fb->type == 'D')) {
+            PUSH_LONG(INST_DATA(obj, u8, fb->u.offset), 3);
+        } else {
+            if(*fb->type == 'L' || *fb->type == '[') {
+                PUSH_0(INST_DATA(obj, uintptr_t, fb->u.offset), 3);
+            } else {
+                PUSH_0(INST_DATA(obj, u4, fb->u.offset), 3);
+            }
+        }
+    })
+
+#ifdef USE_CACHE
+    DEF_OPC_012(OPC_PUTFIELD_QUICK_W, {
+        FieldBlock *fb = RESOLVED_FIELD(pc);
+ 
+        if((*fb->type == 'J') || (*fb->type == 'D')) {
+            Object *obj = (Object *)*--ostack;
+
+            NULL_POINTER_CHECK(obj);
+            INST_DATA(obj, u8, fb->u.offset) = cache.l;
+        } else {
+            Object *obj = (Object *)cache.i.v1;
+
+            NULL_POINTER_CHECK(obj);
+
+            if(*fb->type == 'L' || *fb->type == '[')
+                INST_DATA(obj, uintptr_t, fb->u.offset) = cache.i.v2;
+            else
+                INST_DATA(obj, u4, fb->u.offset) = cache.i.v2;
+        }
+        DISPATCH(0, 3);
+    })
+#else
+    DEF_OPC_012(OPC_PUTFIELD_QUICK_W, {
+        FieldBlock *fb = RESOLVED_FIELD(pc);
+ 
+        if((*fb->type == 'J') || (*fb->type == 'D')) {
+            Object *obj = (Object *)ostack[-3];
+
+            ostack -= 3;
+            NULL_POINTER_CHECK(obj);
+            INST_DATA(obj, u8, fb->u.offset) = *(u8*)&ostack[1];
+        } else {
+            Object *obj = (Object *)ostack[-2];
+
+            ostack -= 2;
+            NULL_POINTER_CHECK(obj);
+
+            if(*fb->type == 'L' || *fb->type == '[')
+                INST_DATA(obj, uintptr_t, fb->u.offset) = ostack[1];
+            else
+                INST_DATA(obj, u4, fb->u.offset) = ostack[1];
+        }
+        DISPATCH(0, 3);
+    })
+#endif
+#endif
+
     DEF_OPC_210(OPC_GETSTATIC2_QUICK, {
         FieldBlock *fb = RESOLVED_FIELD(pc);
         PUSH_LONG(fb->u.static_value.l, 3);
@@ -2114,7 +2229,7 @@ uintptr_t *executeJava() {
 
     DEF_OPC_210(OPC_GETFIELD2_QUICK, {
         Object *obj = (Object *)*--ostack;
-        NULL_POINTER_CHECK(obj);
+        DEREF_NULL_CHECK(obj);
                 
         PUSH_LONG(INST_DATA(obj, u8, SINGLE_INDEX(pc)), 3);
     })
@@ -2122,7 +2237,7 @@ uintptr_t *executeJava() {
 #ifdef USE_CACHE
     DEF_OPC_012(OPC_PUTFIELD2_QUICK, {
         Object *obj = (Object *)*--ostack;
-        NULL_POINTER_CHECK(obj);
+        DEREF_NULL_CHECK(obj);
 
         INST_DATA(obj, u8, SINGLE_INDEX(pc)) = cache.l;
         DISPATCH(0, 3);
@@ -2131,7 +2246,7 @@ uintptr_t *executeJava() {
 #define PUTFIELD_QUICK(type, suffix)                         \
     DEF_OPC_012(OPC_PUTFIELD_QUICK##suffix, {                \
         Object *obj = (Object *)cache.i.v1;                  \
-        NULL_POINTER_CHECK(obj);                             \
+        DEREF_NULL_CHECK(obj);                               \
                                                              \
         INST_DATA(obj, type, SINGLE_INDEX(pc)) = cache.i.v2; \
         DISPATCH(0, 3);                                      \
@@ -2141,7 +2256,7 @@ uintptr_t *executeJava() {
         Object *obj = (Object *)ostack[-3];
 
         ostack -= 3;
-        NULL_POINTER_CHECK(obj);
+        DEREF_NULL_CHECK(obj);
         INST_DATA(obj, u8, SINGLE_INDEX(pc)) = *(u8*)&ostack[1];
         DISPATCH(0, 3);
     })
@@ -2151,7 +2266,7 @@ uintptr_t *executeJava() {
         Object *obj = (Object *)ostack[-2];                 \
                                                             \
         ostack -= 2;                                        \
-        NULL_POINTER_CHECK(obj);                            \
+        DEREF_NULL_CHECK(obj);                              \
         INST_DATA(obj, type, SINGLE_INDEX(pc)) = ostack[1]; \
         DISPATCH(0, 3);                                     \
     })
@@ -2181,6 +2296,57 @@ uintptr_t *executeJava() {
         goto invokeMethod;
     })
 
+    DEF_OPC_210(OPC_INVOKEVIRTUAL_TRIVIAL, {
+        Class *new_class;
+
+        arg1 = ostack - INV_QUICK_ARGS(pc);
+        DEREF_NULL_CHECK(*arg1);
+
+        new_class = (*(Object **)arg1)->class;
+        new_mb = CLASS_CB(new_class)->method_table[INV_QUICK_IDX(pc)];
+
+        goto invokeTrivial;
+    })
+
+    DEF_OPC_210(OPC_INVOKENONVIRT_TRIVIAL, {
+        new_mb = RESOLVED_METHOD(pc);
+        arg1 = ostack - new_mb->args_count;
+        NULL_POINTER_CHECK(*arg1);
+        goto invokeTrivial;
+    })
+
+    DEF_OPC_210(OPC_INVOKESTATIC_TRIVIAL, {
+        new_mb = RESOLVED_METHOD(pc);
+        arg1 = ostack - new_mb->args_count;
+        goto invokeTrivial;
+    })
+
+#ifdef DIRECT
+    DEF_OPC_210(OPC_INVOKEINTERFACE_QUICK, {
+        InterfaceCache *icache = RESOLVED_INTF_CACHE(pc);
+        Class *new_class;
+        int i;
+
+        new_mb = icache->imethod;
+        arg1 = ostack - new_mb->args_count;
+
+        DEREF_NULL_CHECK(*arg1);
+
+        new_class = (*(Object **)arg1)->class;
+
+        for(i = 0; i < INTF_CACHE_SIZE; i++)
+            if(icache->entries[i].class == new_class) {
+                new_mb = icache->entries[i].mb;
+                goto invokeMethod;
+            }
+
+        if((new_mb = lookupInterfaceCache(icache, new_class)) == NULL)
+            THROW_EXCEPTION(java_lang_IncompatibleClassChangeError,
+                            "unimplemented interface");
+
+        goto invokeMethod;
+    })
+#else
     DEF_OPC_210(OPC_INVOKEINTERFACE_QUICK, {
         int mtbl_idx;
         ClassBlock *cb;
@@ -2189,17 +2355,15 @@ uintptr_t *executeJava() {
         new_mb = (MethodBlock *)CP_INFO(cp, INV_INTF_IDX(pc));
         arg1 = ostack - new_mb->args_count;
 
-        NULL_POINTER_CHECK(*arg1);
+        DEREF_NULL_CHECK(*arg1);
 
         cb = CLASS_CB((*(Object **)arg1)->class);
 
         if(cache >= cb->imethod_table_size ||
                   new_mb->class != cb->imethod_table[cache].interface) {
-            for(cache = 0; cache < cb->imethod_table_size &&
-                           new_mb->class != cb->imethod_table[cache].interface;
-                cache++);
+            cache = findIMethodTableIndex(cb, new_mb->class);
 
-            if(cache == cb->imethod_table_size)
+            if(cache == -1)
                 THROW_EXCEPTION(java_lang_IncompatibleClassChangeError,
                                  "unimplemented interface");
 
@@ -2211,6 +2375,7 @@ uintptr_t *executeJava() {
 
         goto invokeMethod;
     })
+#endif
 
 #ifdef JSR292
     DEF_OPC_210(OPC_INVOKEHANDLE, {
@@ -2402,7 +2567,7 @@ uintptr_t *executeJava() {
         Class *new_class;
 
         arg1 = ostack - INV_QUICK_ARGS(pc);
-        NULL_POINTER_CHECK(*arg1);
+        DEREF_NULL_CHECK(*arg1);
 
         new_class = (*(Object **)arg1)->class;
         new_mb = CLASS_CB(new_class)->method_table[INV_QUICK_IDX(pc)];
@@ -2410,6 +2575,82 @@ uintptr_t *executeJava() {
         goto invokeMethod;
     })
 
+invokeTrivial:
+{
+    /* Perform the action of a trivial method (see findTrivialMethod)
+       in place of the call.  At a virtual call site the receiver's
+       method may not be trivial, and it is invoked normally */
+
+    Object *obj = (Object*)*arg1;
+    int trivial = new_mb->trivial;
+    int operand;
+
+    /* At a virtual call site another thread may be resolving the
+       method.  isTrivialMethod sets the field offset before the
+       method's kind, so the kind must be read first */
+    RMBARRIER();
+    operand = new_mb->trivial_operand;
+
+    switch(trivial) {
+        case TRIVIAL_GETFIELD:
+            *arg1 = INST_DATA(obj, u4, operand);
+            ostack = arg1 + 1;
+            break;
+
+        case TRIVIAL_GETFIELD_REF:
+            *arg1 = INST_DATA(obj, uintptr_t, operand);
+            ostack = arg1 + 1;
+            break;
+
+        case TRIVIAL_GETFIELD2:
+            *(u8*)arg1 = INST_DATA(obj, u8, operand);
+            ostack = arg1 + 2;
+            break;
+
+        case TRIVIAL_PUTFIELD:
+            INST_DATA(obj, u4, operand) = arg1[1];
+            ostack = arg1;
+            break;
+
+        case TRIVIAL_PUTFIELD_REF:
+            INST_DATA(obj, uintptr_t, operand) = arg1[1];
+            ostack = arg1;
+            break;
+
+        case TRIVIAL_PUTFIELD2:
+            INST_DATA(obj, u8, operand) = *(u8*)&arg1[1];
+            ostack = arg1;
+            break;
+
+        case TRIVIAL_CONSTANT:
+            *arg1 = operand;
+            ostack = arg1 + 1;
+            break;
+
+        case TRIVIAL_EMPTY:
+            ostack = arg1;
+            break;
+
+        case TRIVIAL_INTRINSIC: {
+            uintptr_t *sp = (*new_mb->intrinsic)(new_mb->class, new_mb, arg1);
+
+            /* The intrinsic can't handle the arguments */
+            if(sp == NULL)
+                goto invokeMethod;
+
+            ostack = sp;
+            break;
+        }
+
+        default:
+            goto invokeMethod;
+    }
+
+    /* In the inlining interpreter DISPATCH only advances the pc, so
+       jump explicitly rather than falling through into invokeMethod */
+    DISPATCH_METHOD_RET(*pc >= OPC_INVOKEINTERFACE_QUICK ? 5 : 3);
+}
+
 invokeMethod:
 {
     /* Create new frame first.  This is also created for natives
@@ -2421,17 +2662,16 @@ invokeMethod:
     frame->last_pc = pc;
     ostack = ALIGN_OSTACK(new_frame + 1);
 
-    if((char*)(ostack + new_mb->max_stack) > ee->stack_end) {
-        if(ee->overflow++) {
-            /* Overflow when we're already throwing stack overflow.
-               Stack extension should be enough to throw exception,
-               so something's seriously gone wrong - abort the VM! */
-            jam_printf("Fatal stack overflow!  Aborting VM.\n");
-            exitVM(1);
-        }
-        ee->stack_end += STACK_RED_ZONE_SIZE;
-        THROW_EXCEPTION(java_lang_StackOverflowError, NULL);
-    }
+#ifdef IMPLICIT_STACK_CHECKS
+    STACK_BANG(ostack + new_mb->max_stack);
+#else
+    /* The stack rarely needs growing, so the check is laid
+       out as a not-taken branch */
+    if(__builtin_expect((char*)(ostack + new_mb->max_stack) > ee->stack_end,
+                        FALSE) &&
+               !growJavaStack(ee, (char*)(ostack + new_mb->max_stack)))
+        goto stackOverflow;
+#endif
 
     new_frame->mb = new_mb;
     new_frame->lvars = arg1;
@@ -2440,33 +2680,37 @@ invokeMethod:
 
     ee->last_frame = new_frame;
 
-    if(new_mb->access_flags & ACC_SYNCHRONIZED) {
-        sync_ob = new_mb->access_flags & ACC_STATIC ? (Object*)new_mb->class
-                                                    : (Object*)*arg1;
-        objectLock(sync_ob);
-    }
-
-    if(new_mb->access_flags & ACC_NATIVE) {
-        ostack = (*new_mb->native_invoker)(new_mb->class, new_mb, arg1);
+    /* A prepared, unsynchronized method needs no further checks */
+    if(__builtin_expect(new_mb->entry != ENTRY_INTERPRETED, FALSE)) {
+        if(new_mb->entry != ENTRY_NATIVE &&
+                new_mb->access_flags & ACC_SYNCHRONIZED) {
+            sync_ob = new_mb->access_flags & ACC_STATIC
+                                ? (Object*)new_mb->class : (Object*)*arg1;
+            objectLock(sync_ob);
+        }
 
-        if(sync_ob)
-            objectUnlock(sync_ob);
+        if(new_mb->access_flags & ACC_NATIVE) {
+            ostack = (*new_mb->native_invoker)(new_mb->class, new_mb, arg1);
 
-        ee->last_frame = frame;
+            if(sync_ob)
+                objectUnlock(sync_ob);
 
-        if(exceptionOccurred0(ee))
-            goto throwException;
-        DISPATCH(0, *pc >= OPC_INVOKEINTERFACE_QUICK ? 5 : 3);
-    } else {
-        PREPARE_MB(new_mb);
+            ee->last_frame = frame;
 
-        frame = new_frame;
-        mb = new_mb;
-        lvars = new_frame->lvars;
-        this = (Object*)lvars[0];
-        pc = (CodePntr)mb->code;
-        cp = &(CLASS_CB(mb->class)->constant_pool);
+            if(exceptionOccurred0(ee))
+                goto throwException;
+            DISPATCH_METHOD_RET(*pc >= OPC_INVOKEINTERFACE_QUICK ? 5 : 3);
+        } else {
+            PREPARE_MB(new_mb);
+        }
     }
+
+    frame = new_frame;
+    mb = new_mb;
+    lvars = new_frame->lvars;
+    this = (Object*)lvars[0];
+    pc = (CodePntr)mb->code;
+    cp = &(CLASS_CB(mb->class)->constant_pool);
     DISPATCH_FIRST
 }
 
@@ -2477,6 +2721,7 @@ methodReturn:
     if(frame->mb == NULL) {
         /* The previous frame is a dummy frame - this indicates
            top of this Java invocation. */
+        IMPLICIT_CHECK_EXIT
         return ostack;
     }
 
@@ -2500,6 +2745,7 @@ methodReturn:
 
 #ifdef INLINING
     DEF_DUMMY_HANDLERS
+#endif
 
 throwNull:
     THROW_EXCEPTION(java_lang_NullPointerException, NULL);
@@ -2513,7 +2759,17 @@ throwOOB:
         snprintf(buff, MAX_INT_DIGITS, "%d", oob_array_index);
         THROW_EXCEPTION(java_lang_ArrayIndexOutOfBoundsException, buff);
     }
-#endif
+
+stackOverflow:
+    if(ee->overflow++) {
+        /* Overflow when we're already throwing stack overflow.
+           Stack extension should be enough to throw exception,
+           so something's seriously gone wrong - abort the VM! */
+        jam_printf("Fatal stack overflow!  Aborting VM.\n");
+        exitVM(1);
+    }
+    useStackRedZone(ee);
+    THROW_EXCEPTION(java_lang_StackOverflowError, NULL);
 
 throwException:
     {
@@ -2527,6 +2783,7 @@ throwException:
 
         if(pc == NULL) {
             ee->exception = excep;
+            IMPLICIT_CHECK_EXIT
             return NULL;
         }
 
@@ -2536,7 +2793,7 @@ throwException:
 
         if(ee->overflow) {
             ee->overflow = FALSE;
-            ee->stack_end -= STACK_RED_ZONE_SIZE;
+            releaseStackRedZone(ee);
         }
 
         /* Setup interpreter to run the found catch block */
@@ -2563,10 +2820,57 @@ throwException:
 int initialiseInterpreter(InitArgs *args) {
 #ifdef DIRECT
     initialiseDirect(args);
+#endif
+#ifdef IMPLICIT_CHECKS
+    nativeCatchFaults();
 #endif
     return TRUE;
 }
 
+#ifdef IMPLICIT_CHECKS
+extern char __start_jam_interp[], __stop_jam_interp[];
+
+static int isInterpreterCode(void *native_pc) {
+    return (char*)native_pc >= __start_jam_interp &&
+           (char*)native_pc < __stop_jam_interp;
+}
+#endif
+
+#ifdef IMPLICIT_NULL_CHECKS
+/* Called by the SIGSEGV handler for a fault on a low address.  If the
+   fault is in the interpreter it is a null dereference, and we return
+   to the executeJava invocation to throw a NullPointerException */
+
+void interpreterNullFault(void *native_pc) {
+    if(isInterpreterCode(native_pc))
+        siglongjmp(*getExecEnv()->implicit_check_env, IMPLICIT_NULL_FAULT);
+}
+#endif
+
+#ifdef IMPLICIT_STACK_CHECKS
+/* Called by the SIGSEGV handler.  A fault in the interpreter on the
+   thread's Java stack is a new frame beyond the stack end.  If the
+   stack can be grown, we return TRUE and the access is repeated.
+   Otherwise we return to the executeJava invocation to throw a
+   StackOverflowError */
+
+int interpreterStackFault(void *native_pc, void *addr) {
+    ExecEnv *ee;
+
+    if(!isInterpreterCode(native_pc))
+        return FALSE;
+
+    ee = getExecEnv();
+    if(!isJavaStackAddress(ee, addr))
+        return FALSE;
+
+    if(growJavaStack(ee, (char*)addr + 1))
+        return TRUE;
+
+    siglongjmp(*ee->implicit_check_env, IMPLICIT_STACK_FAULT);
+}
+#endif
+
 void shutdownInterpreter() {
 #ifdef INLINING
     shutdownInlining();
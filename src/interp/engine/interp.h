@@ -99,6 +99,27 @@
 #define resolvePolyMethod(class, idx) ({ NULL; })
 #endif
 
+/* Opcode execution statistics (see opcodestats.c).  The table is
+   held in a local, so the counting code copied into inlined blocks
+   remains relocatable */
+
+#ifdef OPCODE_STATS
+#define OPCODE_STATS_DEFINITIONS                        \
+    OpcodeStats *opcode_stats = opcodeStats();          \
+    int last_opcode = OPC_NOP;
+
+#define COUNT_OPCODE(opcode)                            \
+{                                                       \
+    int this_opcode = opcode;                           \
+    opcode_stats->opcodes[this_opcode]++;               \
+    opcode_stats->pairs[last_opcode][this_opcode]++;    \
+    last_opcode = this_opcode;                          \
+}
+#else
+#define OPCODE_STATS_DEFINITIONS
+#define COUNT_OPCODE(opcode)
+#endif
+
 /* Include the interpreter variant header */
 
 #ifdef DIRECT
@@ -110,3 +131,70 @@
 #else
 #include "interp-indirect.h"
 #endif /* DIRECT */
+
+/* Implicit checks (enabled by configure, direct interpreter only).
+   A fault is caught by the SIGSEGV handler, which returns to the
+   executeJava invocation's sigsetjmp with the kind of fault (see
+   interpreterNullFault and interpreterStackFault).  The instruction
+   which faulted is the pc saved in the frame, and the exception is
+   thrown from it */
+
+#ifdef IMPLICIT_CHECKS
+#define IMPLICIT_NULL_FAULT  1
+#define IMPLICIT_STACK_FAULT 2
+
+#define IMPLICIT_CHECK_DEFINITIONS                      \
+    sigjmp_buf implicit_check_env;                      \
+    sigjmp_buf *prev_implicit_check_env;
+
+#define IMPLICIT_CHECK_ENTRY                            \
+    prev_implicit_check_env = ee->implicit_check_env;   \
+    ee->implicit_check_env = &implicit_check_env;       \
+                                                        \
+    switch(sigsetjmp(implicit_check_env, FALSE)) {      \
+        case IMPLICIT_NULL_FAULT:                       \
+            frame = ee->last_frame;                     \
+            pc = frame->last_pc;                        \
+            goto throwNull;                             \
+                                                        \
+        case IMPLICIT_STACK_FAULT:                      \
+            frame = ee->last_frame;                     \
+            pc = frame->last_pc;                        \
+            goto stackOverflow;                         \
+    }
+
+#define IMPLICIT_CHECK_EXIT                             \
+    ee->implicit_check_env = prev_implicit_check_env;
+#else
+#define IMPLICIT_CHECK_DEFINITIONS
+#define IMPLICIT_CHECK_ENTRY
+#define IMPLICIT_CHECK_EXIT
+#endif
+
+/* With implicit null checks, a handler which dereferences a reference
+   before it has any other effect uses DEREF_NULL_CHECK.  Instead of
+   testing the reference the pc is saved in the frame, and a null
+   dereference faults.  The barrier stops the compiler moving the
+   dereference above the store.  Field offsets of IMPLICIT_NULL_LIMIT
+   or more are accessed by the _W handlers, which test the reference */
+
+#ifdef IMPLICIT_NULL_CHECKS
+#define DEREF_NULL_CHECK(ref)                           \
+    frame->last_pc = pc;                                \
+    __asm__ __volatile__("" ::: "memory");
+#else
+#define DEREF_NULL_CHECK(ref) NULL_POINTER_CHECK(ref)
+#endif
+
+/* With implicit stack checks, invoking a method touches the last byte
+   of the new frame.  The red zone and the reserved area beyond the
+   committed stack are protected, so this faults if the frame is beyond
+   the stack end, and the SIGSEGV handler grows the stack or throws
+   StackOverflowError.  The pc has already been saved in the frame */
+
+#ifdef IMPLICIT_STACK_CHECKS
+#define STACK_BANG(frame_end)                           \
+    __asm__ __volatile__("" ::: "memory");              \
+    (void)*(volatile char*)((char*)(frame_end) - 1);    \
+    __asm__ __volatile__("" ::: "memory");
+#endif
@@ -0,0 +1,105 @@
+/* Generated by gen-superinsns.c from profile file superinsns.profile */
+
+#define SUPER_INSNS_COUNT 10
+#define SUPER_INSN_MAX_LEN 4
+
+/* OPC_SUPER_0: iload iconst_1 iadd (7500) */
+/* OPC_SUPER_1: iload iload iadd (7000) */
+/* OPC_SUPER_2: iload iload (9000) */
+/* OPC_SUPER_3: iload_1 iload_2 (8500) */
+/* OPC_SUPER_4: iinc iload (8000) */
+/* OPC_SUPER_5: istore iload (6500) */
+/* OPC_SUPER_6: aload_0 iload_1 (6000) */
+/* OPC_SUPER_7: iload_2 iload_3 (5500) */
+/* OPC_SUPER_8: getfield_this getfield_this (5000) */
+/* OPC_SUPER_9: iconst_0 istore (4500) */
+
+#define SUPER_INSN_PATTERNS                                \
+    {OPC_SUPER_0, 3, {1, 1, 1}, {OPC_ILOAD, OPC_ICONST_1, OPC_IADD}}, \
+    {OPC_SUPER_1, 3, {1, 1, 1}, {OPC_ILOAD, OPC_ILOAD, OPC_IADD}}, \
+    {OPC_SUPER_2, 2, {2, 2, 2}, {OPC_ILOAD, OPC_ILOAD}},   \
+    {OPC_SUPER_3, 2, {2, 2, 2}, {OPC_ILOAD_1, OPC_ILOAD_2}}, \
+    {OPC_SUPER_4, 2, {1, 2, 2}, {OPC_IINC, OPC_ILOAD}},    \
+    {OPC_SUPER_5, 2, {1, 1, 2}, {OPC_ISTORE, OPC_ILOAD}},  \
+    {OPC_SUPER_6, 2, {2, 2, 2}, {OPC_ILOAD_0, OPC_ILOAD_1}}, \
+    {OPC_SUPER_7, 2, {2, 2, 2}, {OPC_ILOAD_2, OPC_ILOAD_3}}, \
+    {OPC_SUPER_8, 2, {2, 2, 2}, {OPC_GETFIELD_THIS, OPC_GETFIELD_THIS}}, \
+    {OPC_SUPER_9, 2, {0, 1, 1}, {OPC_ICONST_0, OPC_ISTORE}}, \
+    {-1, 0, {0}, {0}}
+
+#define SUPER_INSN_HANDLERS                                \
+    DEF_SUPER_OPC(OPC_SUPER_0, 1, 1, 1,                    \
+        *ostack++ = lvars[SINGLE_INDEX(pc)];               \
+        pc++;                                              \
+        *ostack++ = 1;                                     \
+        pc++;                                              \
+        ostack--; ostack[-1] = (int)ostack[-1] + (int)ostack[0]; \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_1, 1, 1, 1,                    \
+        *ostack++ = lvars[SINGLE_INDEX(pc)];               \
+        pc++;                                              \
+        *ostack++ = lvars[SINGLE_INDEX(pc)];               \
+        pc++;                                              \
+        ostack--; ostack[-1] = (int)ostack[-1] + (int)ostack[0]; \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_2, 2, 2, 2,                    \
+        *ostack++ = lvars[SINGLE_INDEX(pc)];               \
+        pc++;                                              \
+        *ostack++ = lvars[SINGLE_INDEX(pc)];               \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_3, 2, 2, 2,                    \
+        *ostack++ = lvars[1];                              \
+        pc++;                                              \
+        *ostack++ = lvars[2];                              \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_4, 1, 2, 2,                    \
+        lvars[IINC_LVAR_IDX(pc)] += IINC_DELTA(pc);        \
+        pc++;                                              \
+        *ostack++ = lvars[SINGLE_INDEX(pc)];               \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_5, 1, 1, 2,                    \
+        lvars[SINGLE_INDEX(pc)] = *--ostack;               \
+        pc++;                                              \
+        *ostack++ = lvars[SINGLE_INDEX(pc)];               \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_6, 2, 2, 2,                    \
+        *ostack++ = lvars[0];                              \
+        pc++;                                              \
+        *ostack++ = lvars[1];                              \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_7, 2, 2, 2,                    \
+        *ostack++ = lvars[2];                              \
+        pc++;                                              \
+        *ostack++ = lvars[3];                              \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_8, 2, 2, 2,                    \
+        *ostack++ = INST_DATA(this, u4, GETFIELD_THIS_OFFSET(pc)); \
+        pc++;                                              \
+        *ostack++ = INST_DATA(this, u4, GETFIELD_THIS_OFFSET(pc)); \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+    DEF_SUPER_OPC(OPC_SUPER_9, 0, 1, 1,                    \
+        *ostack++ = 0;                                     \
+        pc++;                                              \
+        lvars[SINGLE_INDEX(pc)] = *--ostack;               \
+        pc++;                                              \
+    )                                                      \
+                                                           \
+
@@ -32,6 +32,7 @@
 #include "class.h"
 #include "classlib.h"
 #include "inlining.h"
+#include "thread.h"
 
 /* To do inlining, we must know which handlers are relocatable.  This
    can be calculated either at runtime or at compile-time as part of
@@ -83,6 +84,31 @@ typedef struct test_code_block {
     BasicBlock *patchers;
 } TestCodeBlock;
 
+/* The instructions within a method whose handlers have been
+   replaced by inlined code, with their original (threaded)
+   handlers.  Used to arm and evict the method's code */
+typedef struct inlined_ins {
+    Instruction *ins;
+    const void *handler;
+    const void *code;
+    int start;
+} InlinedIns;
+
+struct inlined_code {
+    MethodBlock *mb;
+    int armed;
+    int count;
+    int size;
+    InlinedIns *ins;
+    struct inlined_code *next;
+    struct inlined_code *prev;
+};
+
+typedef struct code_chunk {
+    char *base;
+    int len;
+} CodeChunk;
+
 static HashTable code_hash_table;
 
 /* Init options */
@@ -98,6 +124,59 @@ static int profiling;
 static int codemem = 0;
 static int used_codemem = 0;
 
+/* Number of blocks queued for the background inlining thread */
+static int queued_blocks = 0;
+
+/* Code memory statistics (printed by -Xcodestats) */
+static int peak_codemem = 0;
+static int freed_codemem = 0;
+static int failed_allocs = 0;
+static int skipped_dups = 0;
+
+/* Linux perf map (/tmp/perf-<pid>.map), labelling each new
+   super-instruction with the method and instructions it was
+   generated from.  NULL if not enabled */
+static FILE *perf_map = NULL;
+
+/* Once used code memory reaches the high-water mark, blocks are
+   no longer duplicated (for replication or branch patching), so
+   the remaining memory is kept for new sequences.  Duplicates are
+   an optimisation of already inlined code, while a sequence which
+   can't be allocated stays as threaded code */
+static unsigned int codemem_high_water;
+
+#define CODEMEM_LOW() (used_codemem >= codemem_high_water)
+
+/* Cold inlined code is evicted by the GC while the world is
+   stopped (see sweepCodeMemory).  Methods with inlined code
+   are linked onto a list, which is modified with suspension
+   disabled so it is always consistent when scanned */
+static InlinedCode *inlined_methods = NULL;
+
+/* Number of threads generating code.  A block is allocated
+   before it is installed, so no sweep is done while non-zero */
+static int inlining_count = 0;
+
+/* The code memory chunks, sorted by address.  Used to find
+   the references to code memory from a thread's C stack */
+static CodeChunk *code_chunks = NULL;
+static int code_chunks_count = 0;
+
+/* References found by a sweep.  If there are more than this,
+   no code is evicted */
+#define MAX_CODE_REFS 256
+
+static char *code_refs[MAX_CODE_REFS];
+static int code_refs_count;
+
+/* Sweep statistics (printed by -Xcodestats) */
+static int sweeps = 0;
+static int skipped_sweeps = 0;
+static int evicted_methods = 0;
+static int evicted_codemem = 0;
+static int swept_codemem = 0;
+static int swept_failed_allocs = 0;
+
 static int sys_page_size;
 static int codemem_increment;
 static unsigned int max_codemem;
@@ -109,6 +188,23 @@ static char *min_entry_point = (char*)-1;
 static char *max_entry_point  = NULL;
 
 static int enabled;
+
+/* Hot blocks are queued for inlining by a background thread
+   (see queueInlining).  A block is identified by its start pc */
+
+#define INLINE_QUEUE_SIZE 256
+
+typedef struct inline_request {
+    MethodBlock *mb;
+    Instruction *pc;
+} InlineRequest;
+
+static int background_inlining;
+static VMWaitLock inline_queue_lock;
+static InlineRequest inline_queue[INLINE_QUEUE_SIZE];
+static int inline_queue_head = 0;
+static int inline_queue_count = 0;
+static MethodBlock *volatile inlining_mb = NULL;
 int inlining_inited = FALSE;
 
 static char *goto_start;
@@ -215,6 +311,7 @@ int initialiseInlining(InitArgs *args) {
 
         sys_page_size = getpagesize();
         max_codemem = ROUND(args->codemem, sys_page_size);
+        codemem_high_water = max_codemem - max_codemem / 8;
         codemem_increment = ROUND(CODE_INCREMENT, sys_page_size);
 
         branch_patching_dup = args->branch_patching_dup;
@@ -225,6 +322,19 @@ int initialiseInlining(InitArgs *args) {
 
         print_codestats = args->print_codestats;
         profiling = args->profiling;
+
+        /* Without profiling blocks are inlined on first execution,
+           and there is nothing to queue */
+        background_inlining = profiling && args->background_inlining;
+        initVMWaitLock(inline_queue_lock);
+
+        if(args->perf_map) {
+            char name[32];
+
+            sprintf(name, "/tmp/perf-%d.map", getpid());
+            if((perf_map = fopen(name, "w")) == NULL)
+                jam_fprintf(stderr, "Couldn't open perf map %s\n", name);
+        }
     }
 
     inlining_inited = TRUE;
@@ -233,9 +343,49 @@ int initialiseInlining(InitArgs *args) {
 
 void shutdownInlining() {
     if(print_codestats) {
+        CodeBlockHeader *block;
+        int chunks = 0, largest = 0;
+
+        for(block = code_free_list; block != NULL; block = block->u.next) {
+            if(block->len > largest)
+                largest = block->len;
+            chunks++;
+        }
+
         jam_printf("Allocated codemem: %d\n", codemem);
-        jam_printf("Used codemem: %d\n", used_codemem);
+        jam_printf("Used codemem: %d (peak %d)\n", used_codemem,
+                   peak_codemem);
+        jam_printf("Freed codemem: %d\n", freed_codemem);
+        jam_printf("Free codemem chunks: %d (largest %d)\n", chunks, largest);
+        jam_printf("Failed code allocations: %d\n", failed_allocs);
+        jam_printf("Duplicates skipped (codemem low): %d\n", skipped_dups);
+        jam_printf("Code memory sweeps: %d (skipped %d)\n", sweeps,
+                   skipped_sweeps);
+        jam_printf("Methods evicted: %d (codemem %d)\n", evicted_methods,
+                   evicted_codemem);
+        jam_printf("Blocks queued for inlining: %d\n", queued_blocks);
     }
+
+    if(perf_map != NULL)
+        fclose(perf_map);
+}
+
+/* Code memory usage, reported as non-heap memory by the
+   management interfaces */
+void codeMemoryUsage(long long *used, long long *committed,
+                     long long *max) {
+    *used = used_codemem;
+    *committed = codemem;
+    *max = enabled ? max_codemem : 0;
+}
+
+long long peakCodeMem() {
+    return peak_codemem;
+}
+
+/* Code memory used after the last sweep which evicted code */
+long long sweptCodeMem() {
+    return swept_codemem;
 }
 
 int codeHash(unsigned char *pntr, int len) {
@@ -294,6 +444,46 @@ out:
     }
 }
 
+/* Re-install a method's inlined code once it has been executed
+   after being armed.  Called with the rewrite lock held, or by
+   the GC */
+static void disarmInlinedCode(InlinedCode *code) {
+    int i;
+
+    for(i = 0; i < code->count; i++)
+        code->ins[i].ins->handler = code->ins[i].code;
+
+    code->armed = FALSE;
+}
+
+/* Replace a method's inlined code by the profiling handler, so
+   its first execution can be seen (see inlineProfiledBlock) */
+static void armInlinedCode(InlinedCode *code) {
+    const void *handler = handler_entry_points[0][OPC_PROFILE_REWRITER];
+    int i;
+
+    for(i = 0; i < code->count; i++)
+        code->ins[i].ins->handler = handler;
+
+    code->armed = TRUE;
+}
+
+/* Called by the GC, with the world stopped */
+static void unlinkInlinedCode(InlinedCode *code) {
+    if(code->prev)
+        code->prev->next = code->next;
+    else
+        inlined_methods = code->next;
+
+    if(code->next)
+        code->next->prev = code->prev;
+
+    code->mb->inlined_code = NULL;
+
+    gcPendingFree(code->ins);
+    gcPendingFree(code);
+}
+
 void freeMethodInlinedInfo(MethodBlock *mb) {
     Instruction *instruction = mb->code;
     CodeBlockHeader **blocks = mb->code;
@@ -305,6 +495,19 @@ void freeMethodInlinedInfo(MethodBlock *mb) {
     if(!enabled)
         return;
 
+#ifdef OPCODE_STATS
+    opcodeStatsFreeMethod(mb);
+#endif
+
+    /* The handlers of an armed method are re-installed,
+       so its blocks are found when scanning below */
+    if(mb->inlined_code != NULL) {
+        if(mb->inlined_code->armed)
+            disarmInlinedCode(mb->inlined_code);
+
+        unlinkInlinedCode(mb->inlined_code);
+    }
+
     /* Scan handlers within the method */
 
     for(i = mb->code_size; i--; instruction++) {
@@ -352,6 +555,7 @@ void freeMethodInlinedInfo(MethodBlock *mb) {
 
             /* Update code stats */
             used_codemem -= block->len;
+            freed_codemem += block->len;
         } else
             block->u.ref_count--;
     }
@@ -389,6 +593,40 @@ void freeMethodInlinedInfo(MethodBlock *mb) {
     }
 }
 
+/* Add a newly mapped chunk of code memory to the chunk table,
+   keeping it sorted by address */
+static void addCodeChunk(char *base, int len) {
+    int i;
+
+    code_chunks = sysRealloc(code_chunks,
+                             (code_chunks_count + 1) * sizeof(CodeChunk));
+
+    for(i = code_chunks_count; i > 0 && code_chunks[i-1].base > base; i--)
+        code_chunks[i] = code_chunks[i-1];
+
+    code_chunks[i].base = base;
+    code_chunks[i].len = len;
+    code_chunks_count++;
+}
+
+static int isCodeAddress(char *addr) {
+    int low = 0, high = code_chunks_count - 1;
+
+    while(low <= high) {
+        int mid = (low + high) / 2;
+        CodeChunk *chunk = &code_chunks[mid];
+
+        if(addr < chunk->base)
+            high = mid - 1;
+        else if(addr >= chunk->base + chunk->len)
+            low = mid + 1;
+        else
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 CodeBlockHeader *expandCodeMemory(int size) {
     CodeBlockHeader *block;
     int remainder;
@@ -408,6 +646,8 @@ CodeBlockHeader *expandCodeMemory(int size) {
     if(block == MAP_FAILED)
         return NULL;
 
+    addCodeChunk((char*)block, inc);
+
     block->len = size;
     if((remainder = inc - size) >= sizeof(CodeBlockHeader)) {
         CodeBlockHeader *rem = (CodeBlockHeader*)((char*)block + size);
@@ -448,14 +688,17 @@ CodeBlockHeader *allocCodeBlock(int code_size) {
             code_free_list = block->u.next;
     } else {
         /* No block big enough.  Need to allocate a new code chunk */
-        if((block = expandCodeMemory(size)) == NULL)
+        if((block = expandCodeMemory(size)) == NULL) {
+            failed_allocs++;
             return NULL;
+        }
     }
 
     block->code_len = code_size;
 
     /* Update code stats */
-    used_codemem += block->len;
+    if((used_codemem += block->len) > peak_codemem)
+        peak_codemem = used_codemem;
 
     return block;
 }
@@ -510,9 +753,11 @@ CodeBlockHeader *foundExistingBlock(TestCodeBlock *test_block,
     /* If the number of usages of the block has reached the replication
        threshold duplicate the block */
     if(existing_block->u.ref_count >= replication_threshold) {
-        CodeBlockHeader *dup_block = newDuplicateBlock(test_block);
+        CodeBlockHeader *dup_block;
 
-        if(dup_block != NULL)
+        if(CODEMEM_LOW())
+            skipped_dups++;
+        else if((dup_block = newDuplicateBlock(test_block)) != NULL)
             return dup_block;
     }
 
@@ -524,11 +769,19 @@ CodeBlockHeader *foundExistingBlock(TestCodeBlock *test_block,
 }
 
 CodeBlockHeader *findCodeBlock(TestCodeBlock *block) {
+    int dup = branch_patching_dup && block->patchers != NULL;
     CodeBlockHeader *ret_block;
 
     lockHashTable(code_hash_table);
 
-    if(branch_patching_dup && block->patchers != NULL)
+    /* When code memory is low, a block with external jumps
+       is shared rather than duplicated and patched */
+    if(dup && CODEMEM_LOW()) {
+        skipped_dups++;
+        dup = FALSE;
+    }
+
+    if(dup)
         ret_block = newDuplicateBlock(block);
     else {
         /* Search hash table.  Add if absent, scavenge and not locked */
@@ -669,14 +922,73 @@ void patchExternalJumps(TestCodeBlock *test_block, CodeBlockHeader *new_block) {
 
 #define INUM(mb, block, off) &block->start[off] - (Instruction*)mb->code
 
+void rewriteLock(Thread *self);
+void rewriteUnlock(Thread *self);
+
+/* Get the method's inlined code, with room for len more
+   instructions.  Called with the rewrite lock held */
+static InlinedCode *inlinedCode(MethodBlock *mb, int len, Thread *self) {
+    InlinedCode *code = mb->inlined_code;
+
+    if(code == NULL) {
+        code = sysMalloc(sizeof(InlinedCode));
+        code->mb = mb;
+        code->armed = FALSE;
+        code->count = code->size = 0;
+        code->ins = NULL;
+        code->prev = NULL;
+
+        fastDisableSuspend(self);
+
+        if((code->next = inlined_methods) != NULL)
+            code->next->prev = code;
+        inlined_methods = code;
+        mb->inlined_code = code;
+
+        fastEnableSuspend(self);
+
+    } else if(code->armed)
+        disarmInlinedCode(code);
+
+    if(code->count + len > code->size) {
+        code->size = code->count + len + 8;
+        code->ins = sysRealloc(code->ins, code->size * sizeof(InlinedIns));
+    }
+
+    return code;
+}
+
+static void installCode(InlinedCode *code, Instruction *ins, char *code_pntr,
+                        int start) {
+
+    InlinedIns *entry = &code->ins[code->count++];
+
+    entry->ins = ins;
+    entry->handler = ins->handler;
+    entry->code = code_pntr;
+    entry->start = start;
+
+    ins->handler = code_pntr;
+    MBARRIER();
+}
+
 void updateSeqStarts(MethodBlock *mb, char *code_pntr, BasicBlock *start,
                      int ins_start, BasicBlock *end, int ins_end) {
+    Thread *self = threadSelf();
+    InlinedCode *code;
+    BasicBlock *block;
+    int len = 1;
+
+    for(block = start; block != end; block = block->next)
+        len++;
+
+    rewriteLock(self);
+    code = inlinedCode(mb, len, self);
 
     TRACE("Updating start block (%d len %d) %p\n", INUM(mb, start, ins_start),
           start->length - ins_start, code_pntr);
 
-    start->start[ins_start].handler = code_pntr;
-    MBARRIER();
+    installCode(code, &start->start[ins_start], code_pntr, TRUE);
 
     if(start != end) {
         code_pntr += insSeqCodeLen(start, ins_start, start->length - ins_start);
@@ -685,18 +997,30 @@ void updateSeqStarts(MethodBlock *mb, char *code_pntr, BasicBlock *start,
             TRACE("Updating block join (%d len %d) %p\n", INUM(mb, start, 0),
                   start->length, code_pntr);
 
-            start->start->handler = code_pntr;
-            MBARRIER();
-
+            installCode(code, start->start, code_pntr, FALSE);
             code_pntr += insSeqCodeLen(start, 0, start->length);
         }
 
         TRACE("Updating end block (%d len %d) %p\n", INUM(mb, end, 0),
               ins_end + 1, code_pntr);
 
-        end->start->handler = code_pntr;
-        MBARRIER();
+        installCode(code, end->start, code_pntr, FALSE);
     }
+
+    rewriteUnlock(self);
+}
+
+void writePerfMapEntry(MethodBlock *mb, CodeBlockHeader *block, int len,
+                       Instruction *start, Instruction *end) {
+    char buff[256];
+
+    slash2DotsBuff(CLASS_CB(mb->class)->name, buff, sizeof(buff));
+
+    fprintf(perf_map, "%lx %x %s.%s%s [%d-%d] line %d\n",
+            (unsigned long)(block + 1), len, buff, mb->name, mb->type,
+            (int)(start - (Instruction*)mb->code),
+            (int)(end - (Instruction*)mb->code), mapPC2LineNo(mb, start));
+    fflush(perf_map);
 }
 
 void inlineSequence(MethodBlock *mb, BasicBlock *start, int ins_start,
@@ -733,6 +1057,17 @@ void inlineSequence(MethodBlock *mb, BasicBlock *start, int ins_start,
               INUM(mb, start, ins_start),
               INUM(mb, end, ins_end));
 
+        /* Label a newly created block.  Existing blocks are labelled
+           with the method they were first generated from */
+        if(perf_map != NULL && hashed_block->u.ref_count <= 0)
+            writePerfMapEntry(mb, hashed_block, code_len,
+                              &start->start[ins_start], &end->start[ins_end]);
+
+#ifdef OPCODE_STATS
+        opcodeStatsAddBlock(mb, &start->start[ins_start],
+                            &end->start[ins_end]);
+#endif
+
         /* Replace the start handler with new inlined block,
            and update block joins to point within the sequence */
         updateSeqStarts(mb, (char*)(hashed_block + 1), start, ins_start,
@@ -855,6 +1190,13 @@ void rewriteUnlock(Thread *self) {
     unlockVMLock(rewrite_lock, self);
 }
 
+/* Called once a thread has finished generating code */
+static void endInlining(Thread *self) {
+    rewriteLock(self);
+    inlining_count--;
+    rewriteUnlock(self);
+}
+
 void removeFromProfile(MethodBlock *mb, BasicBlock *block) {
     ProfileInfo *profile_info = block->u.profile.profiled;
 
@@ -920,6 +1262,7 @@ void inlineBlock(MethodBlock *mb, BasicBlock *block, Thread *self) {
     if(end->next)
         end->next->prev = NULL;
 
+    inlining_count++;
     rewriteUnlock(self);
 
     TRACE("%s.%s InlineBlock trigger %d start %d end %d\n",
@@ -939,6 +1282,8 @@ void inlineBlock(MethodBlock *mb, BasicBlock *block, Thread *self) {
         sysFree(start);
         start = next;
     }
+
+    endInlining(self);
 }
 
 /* If profiling is enabled, basic blocks are not inlined immediately
@@ -957,6 +1302,7 @@ void addToProfile(MethodBlock *mb, BasicBlock *block, Thread *self) {
 
     TRACE("Adding block (start %p) to profile\n", block->start);
     info->profile_count = 0;
+    info->queued = FALSE;
     info->block = block;
 
     block->u.profile.profiled = info;
@@ -976,11 +1322,14 @@ void prepareBlock(MethodBlock *mb, BasicBlock *block, Thread *self) {
     if(profiling)
         addToProfile(mb, block, self);
     else {
+        inlining_count++;
         rewriteUnlock(self);
 
         inlineBlocks(mb, block, block);
         sysFree(block->opcodes);
         sysFree(block);
+
+        endInlining(self);
     }
 }
 
@@ -1047,6 +1396,218 @@ void checkInliningQuickenedInstruction(Instruction *pc, MethodBlock *mb) {
     }
 }
 
+/* Add a block to the background inlining queue.  Called with the
+   rewrite lock held.  The queue is modified with suspension disabled,
+   so it is always consistent when scanned by the GC.  Returns FALSE
+   if the queue is full, in which case the caller inlines the code
+   itself */
+static int queueInlining(MethodBlock *mb, Instruction *pc, Thread *self) {
+    int queued = FALSE;
+
+    fastDisableSuspend(self);
+    lockVMWaitLock(inline_queue_lock, self);
+
+    if(inline_queue_count < INLINE_QUEUE_SIZE) {
+        InlineRequest *request = &inline_queue[(inline_queue_head +
+                             inline_queue_count++) % INLINE_QUEUE_SIZE];
+
+        request->mb = mb;
+        request->pc = pc;
+
+        notifyVMWaitLock(inline_queue_lock, self);
+        queued = TRUE;
+    }
+
+    unlockVMWaitLock(inline_queue_lock, self);
+    fastEnableSuspend(self);
+
+    return queued;
+}
+
+/* The background inlining thread.  The interpreter continues to
+   execute the block's threaded code until it has been inlined,
+   when its handler is atomically replaced (as when inlining by
+   the executing thread).  A queued block may have already been
+   inlined (with a neighbouring block), and is ignored */
+static void inliningThreadLoop(Thread *self) {
+    for(;;) {
+        InlineRequest request;
+        ProfileInfo *info;
+
+        disableSuspend(self);
+        lockVMWaitLock(inline_queue_lock, self);
+
+        while(inline_queue_count == 0)
+            waitVMWaitLock(inline_queue_lock, self);
+
+        unlockVMWaitLock(inline_queue_lock, self);
+        enableSuspend(self);
+
+        /* Take the request, marking the method as being inlined
+           so its class can't be unloaded while in progress */
+        fastDisableSuspend(self);
+        lockVMWaitLock(inline_queue_lock, self);
+
+        request = inline_queue[inline_queue_head];
+        inline_queue_head = (inline_queue_head + 1) % INLINE_QUEUE_SIZE;
+        inline_queue_count--;
+        inlining_mb = request.mb;
+
+        unlockVMWaitLock(inline_queue_lock, self);
+        fastEnableSuspend(self);
+
+        rewriteLock(self);
+
+        for(info = request.mb->profile_info; info != NULL &&
+                             info->block->start != request.pc;
+            info = info->next);
+
+        if(info != NULL)
+            inlineBlock(request.mb, info->block, self);
+        else
+            rewriteUnlock(self);
+
+        inlining_mb = NULL;
+    }
+}
+
+/* Called by the GC to mark the classes of methods waiting to be
+   inlined.  The class can't be unloaded until it has been */
+void markInliningQueue() {
+    int i;
+
+    if(inlining_mb != NULL)
+        markRoot((Object*)inlining_mb->class);
+
+    for(i = 0; i < inline_queue_count; i++)
+        markRoot((Object*)inline_queue[(inline_queue_head + i)
+                                       % INLINE_QUEUE_SIZE].mb->class);
+}
+
+/* Scan a thread's C stack for references to code memory.  The
+   registers of a suspended thread are saved on its stack by the
+   suspend signal, so this includes the code it is executing */
+void scanThreadCodeRefs(Thread *thread) {
+    uintptr_t *slot = getStackTop(thread);
+    uintptr_t *end = getStackBase(thread);
+
+    for(; slot < end; slot++)
+        if(isCodeAddress((char*)*slot)) {
+            if(code_refs_count < MAX_CODE_REFS)
+                code_refs[code_refs_count] = (char*)*slot;
+            code_refs_count++;
+        }
+}
+
+static int codeReferenced(InlinedCode *code) {
+    int i, j;
+
+    for(i = 0; i < code->count; i++)
+        if(code->ins[i].start) {
+            char *block = (char*)code->ins[i].code - sizeof(CodeBlockHeader);
+            int len = ((CodeBlockHeader*)block)->len;
+
+            for(j = 0; j < code_refs_count; j++)
+                if(code_refs[j] >= block && code_refs[j] < block + len)
+                    return TRUE;
+        }
+
+    return FALSE;
+}
+
+/* Restore a method's threaded handlers and free its blocks (as
+   in freeMethodInlinedInfo).  The blocks are freed one at a time,
+   as sorting a list of blocks may allocate memory, which can't be
+   done with the world stopped */
+static void evictInlinedCode(InlinedCode *code) {
+    int i;
+
+    for(i = 0; i < code->count; i++) {
+        InlinedIns *entry = &code->ins[i];
+        CodeBlockHeader *block = ((CodeBlockHeader*)entry->code) - 1;
+
+        entry->ins->handler = entry->handler;
+
+        if(!entry->start)
+            continue;
+
+        if(block->u.ref_count <= 0) {
+            if(block->u.ref_count == 0)
+                deleteHashEntry(code_hash_table, block, FALSE);
+
+            /* Update code stats */
+            used_codemem -= block->len;
+            freed_codemem += block->len;
+            evicted_codemem += block->len;
+
+            addToFreeList(&block, 1);
+        } else
+            block->u.ref_count--;
+    }
+
+#ifdef OPCODE_STATS
+    opcodeStatsFreeMethod(code->mb);
+#endif
+
+    unlinkInlinedCode(code);
+    evicted_methods++;
+}
+
+/* Called by the GC with the world stopped.  Once code memory is
+   low (or an allocation has failed), a sweep evicts the methods
+   whose inlined code hasn't been executed since the previous
+   sweep, and arms the rest.  An evicted method executes its
+   threaded code, and the memory is used for new sequences.
+   Code is not evicted while a thread may be executing it, and
+   live code is not moved, as its address may be held by a
+   thread or in a jump patched into another block */
+void sweepCodeMemory() {
+    Thread *self = threadSelf();
+    InlinedCode *code, *next;
+
+    if(!enabled || !(CODEMEM_LOW() || failed_allocs != swept_failed_allocs))
+        return;
+
+    /* A thread holding the rewrite lock may have been suspended
+       while modifying handlers, and a thread generating code
+       may have allocated blocks which aren't yet installed */
+    if(!tryLockVMLock(rewrite_lock, self)) {
+        skipped_sweeps++;
+        return;
+    }
+
+    if(inlining_count != 0) {
+        rewriteUnlock(self);
+        skipped_sweeps++;
+        return;
+    }
+
+    swept_failed_allocs = failed_allocs;
+    sweeps++;
+
+    code_refs_count = 0;
+    scanThreadsCodeRefs();
+
+    for(code = inlined_methods; code != NULL; code = next) {
+        next = code->next;
+
+        if(!code->armed)
+            armInlinedCode(code);
+        else if(code_refs_count <= MAX_CODE_REFS && !codeReferenced(code))
+            evictInlinedCode(code);
+    }
+
+    swept_codemem = used_codemem;
+    rewriteUnlock(self);
+}
+
+int initialiseInliningThread() {
+    if(background_inlining)
+        createVMThread("Inlining", inliningThreadLoop);
+
+    return TRUE;
+}
+
 /* Search the profile list for the block and inline if the execution
    threshold has been reached.  The profile list is per-method, and
    blocks are added to the head of the list.  Testing shows 70% of
@@ -1065,9 +1626,36 @@ void *inlineProfiledBlock(Instruction *pc, MethodBlock *mb, int force_inlining)
     for(info = mb->profile_info; info != NULL && info->block->start != pc;
         info = info->next);
 
+    /* If not profiled, the block may be inlined code which has
+       been armed by a sweep.  Its execution re-installs the
+       method's code (see sweepCodeMemory) */
+    if(info == NULL && mb->inlined_code != NULL && mb->inlined_code->armed)
+        disarmInlinedCode(mb->inlined_code);
+
+    /* A thread may have dispatched to the profiling handler
+       just before the block was queued */
+    if(info != NULL && info->queued && !force_inlining) {
+        ret = (void*)info->handler;
+        rewriteUnlock(self);
+        return ret;
+    }
+
     if(info != NULL && (force_inlining ||
                         info->profile_count++ >= profile_threshold)) {
 
+        /* A queued block is no longer profiled.  It executes its
+           original code until the inlining thread has inlined it,
+           so it doesn't take the rewrite lock on each execution */
+        if(!force_inlining && background_inlining &&
+                              queueInlining(mb, pc, self)) {
+            queued_blocks++;
+            info->queued = TRUE;
+            info->block->start->handler = info->handler;
+            ret = (void*)info->handler;
+            rewriteUnlock(self);
+            return ret;
+        }
+
         inlineBlock(mb, info->block, self);
         return NULL;
     }
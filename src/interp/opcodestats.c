@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Must be included first to get configure options */
+#include "jam.h"
+
+#ifdef OPCODE_STATS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "thread.h"
+
+/* Opcode execution statistics.  These are built in by configuring
+   with --enable-opcode-stats, and enabled with -Xopcodestats.  The
+   interpreter counts each executed opcode, and each pair of opcodes
+   executed in sequence (see COUNT_OPCODE in interp.h).  The counts
+   aren't updated atomically, so with several threads they are
+   approximate.
+
+   With the direct interpreter, the counts are of the original
+   bytecodes.  The inlining interpreter counts the executed handler,
+   which may be a quickened form.  It also counts the executions of
+   each instruction, and the count of the first instruction in an
+   inlined block gives the number of times the block was executed */
+
+/* Opcodes of an inlined block shown in the report */
+#define MAX_BLOCK_OPCODES 12
+
+static char *opcode_names[256] = {
+    "nop", "aconst_null", "iconst_m1", "iconst_0", "iconst_1", "iconst_2",
+    "iconst_3", "iconst_4", "iconst_5", "lconst_0", "lconst_1", "fconst_0",
+    "fconst_1", "fconst_2", "dconst_0", "dconst_1", "bipush", "sipush", "ldc",
+    "ldc_w", "ldc2_w", "iload", "lload", "fload", "dload", "aload", "iload_0",
+    "iload_1", "iload_2", "iload_3", "lload_0", "lload_1", "lload_2",
+    "lload_3", "fload_0", "fload_1", "fload_2", "fload_3", "dload_0",
+    "dload_1", "dload_2", "dload_3", "aload_0", "aload_1", "aload_2",
+    "aload_3", "iaload", "laload", "faload", "daload", "aaload", "baload",
+    "caload", "saload", "istore", "lstore", "fstore", "dstore", "astore",
+    "istore_0", "istore_1", "istore_2", "istore_3", "lstore_0", "lstore_1",
+    "lstore_2", "lstore_3", "fstore_0", "fstore_1", "fstore_2", "fstore_3",
+    "dstore_0", "dstore_1", "dstore_2", "dstore_3", "astore_0", "astore_1",
+    "astore_2", "astore_3", "iastore", "lastore", "fastore", "dastore",
+    "aastore", "bastore", "castore", "sastore", "pop", "pop2", "dup",
+    "dup_x1", "dup_x2", "dup2", "dup2_x1", "dup2_x2", "swap", "iadd", "ladd",
+    "fadd", "dadd", "isub", "lsub", "fsub", "dsub", "imul", "lmul", "fmul",
+    "dmul", "idiv", "ldiv", "fdiv", "ddiv", "irem", "lrem", "frem", "drem",
+    "ineg", "lneg", "fneg", "dneg", "ishl", "lshl", "ishr", "lshr", "iushr",
+    "lushr", "iand", "land", "ior", "lor", "ixor", "lxor", "iinc", "i2l",
+    "i2f", "i2d", "l2i", "l2f", "l2d", "f2i", "f2l", "f2d", "d2i", "d2l",
+    "d2f", "i2b", "i2c", "i2s", "lcmp", "fcmpl", "fcmpg", "dcmpl", "dcmpg",
+    "ifeq", "ifne", "iflt", "ifge", "ifgt", "ifle", "if_icmpeq", "if_icmpne",
+    "if_icmplt", "if_icmpge", "if_icmpgt", "if_icmple", "if_acmpeq",
+    "if_acmpne", "goto", "jsr", "ret", "tableswitch", "lookupswitch",
+    "ireturn", "lreturn", "freturn", "dreturn", "areturn", "return",
+    "getstatic", "putstatic", "getfield", "putfield", "invokevirtual",
+    "invokespecial", "invokestatic", "invokeinterface", "invokedynamic",
+    "new", "newarray", "anewarray", "arraylength", "athrow", "checkcast",
+    "instanceof", "monitorenter", "monitorexit", "wide", "multianewarray",
+    "ifnull", "ifnonnull", "goto_w", "jsr_w", NULL, "ldc_quick",
+    "ldc_w_quick", NULL, "getfield_quick", "putfield_quick",
+    "getfield2_quick", "putfield2_quick", "getstatic_quick",
+    "putstatic_quick", "getstatic2_quick", "putstatic2_quick",
+    "invokevirtual_quick", "invokenonvirtual_quick", "invokesuper_quick",
+    "getfield_quick_ref", "putfield_quick_ref", "getstatic_quick_ref",
+    "putstatic_quick_ref", "getfield_this_ref", "miranda_bridge",
+    "abstract_method_error", "inline_rewriter", "profile_rewriter",
+    "invokevirtual_quick_w", "getfield_quick_w", "putfield_quick_w",
+    "getfield_this", "lock", "aload_this", "invokestatic_quick", "new_quick",
+    NULL, "anewarray_quick", NULL, NULL, "checkcast_quick",
+    "instanceof_quick", NULL, NULL, NULL, "multianewarray_quick",
+    "invokehandle", "invokebasic", "linktospecial", "linktovirtual",
+    "linktointerface", "invokeinterface_quick", "invokedynamic_quick",
+    "invokevirtual_trivial", "invokenonvirt_trivial", "invokestatic_trivial",
+    NULL, NULL
+};
+
+/* When disabled, the interpreter counts into a discarded
+   table.  This avoids a test on every dispatch */
+static OpcodeStats stats, discard;
+static int report_size = 0;
+
+typedef struct pair_count {
+    unsigned long long count;
+    unsigned char first;
+    unsigned char second;
+} PairCount;
+
+#ifdef INLINING
+typedef struct inlined_block {
+    MethodBlock *mb;
+    Instruction *start;
+    Instruction *end;
+    struct inlined_block *next;
+} InlinedBlock;
+
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static InlinedBlock *blocks = NULL;
+static int blocks_count = 0;
+#endif
+
+OpcodeStats *opcodeStats() {
+    return report_size ? &stats : &discard;
+}
+
+static char *opcodeName(int opcode, char *buff) {
+    if(opcode_names[opcode] != NULL)
+        return opcode_names[opcode];
+
+    sprintf(buff, "<%d>", opcode);
+    return buff;
+}
+
+#ifdef INLINING
+void opcodeStatsAddBlock(MethodBlock *mb, Instruction *start,
+                         Instruction *end) {
+    InlinedBlock *block;
+    Thread *self;
+
+    if(!report_size)
+        return;
+
+    block = sysMalloc(sizeof(InlinedBlock));
+    block->mb = mb;
+    block->start = start;
+    block->end = end;
+
+    /* The list is modified with suspension disabled, so
+       the lock is never held by a suspended thread */
+    self = threadSelf();
+    fastDisableSuspend(self);
+    pthread_mutex_lock(&blocks_lock);
+
+    block->next = blocks;
+    blocks = block;
+    blocks_count++;
+
+    pthread_mutex_unlock(&blocks_lock);
+    fastEnableSuspend(self);
+}
+
+/* Called by the GC when a method's class is unloaded, or its
+   inlined code is evicted.  Its blocks are forgotten */
+
+void opcodeStatsFreeMethod(MethodBlock *mb) {
+    InlinedBlock **block_pntr = &blocks;
+
+    if(!report_size)
+        return;
+
+    pthread_mutex_lock(&blocks_lock);
+
+    while(*block_pntr != NULL) {
+        InlinedBlock *block = *block_pntr;
+
+        if(block->mb == mb) {
+            *block_pntr = block->next;
+            gcPendingFree(block);
+            blocks_count--;
+        } else
+            block_pntr = &block->next;
+    }
+
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+static int compareBlocks(const void *pntr1, const void *pntr2) {
+    uintptr_t count1 = (*(InlinedBlock**)pntr1)->start->count;
+    uintptr_t count2 = (*(InlinedBlock**)pntr2)->start->count;
+
+    return count1 < count2 ? 1 : count1 > count2 ? -1 : 0;
+}
+
+static void printBlocks() {
+    InlinedBlock **sorted, *block;
+    char buff[256];
+    int i, count;
+
+    pthread_mutex_lock(&blocks_lock);
+
+    if(blocks_count == 0)
+        goto out;
+
+    sorted = sysMalloc(blocks_count * sizeof(InlinedBlock*));
+
+    for(count = 0, block = blocks; block != NULL; block = block->next)
+        sorted[count++] = block;
+
+    qsort(sorted, count, sizeof(InlinedBlock*), compareBlocks);
+
+    jam_printf("\nInlined blocks (%d):\n", count);
+    jam_printf("%14s  method [instructions] / opcodes\n", "executed");
+
+    for(i = 0; i < count && i < report_size; i++) {
+        MethodBlock *mb = sorted[i]->mb;
+        Instruction *ins, *start = sorted[i]->start;
+        Instruction *end = sorted[i]->end;
+        int len;
+
+        jam_printf("%14llu  %s.%s%s [%d-%d]\n",
+                   (unsigned long long)start->count,
+                   slash2DotsBuff(CLASS_CB(mb->class)->name, buff,
+                                  sizeof(buff)), mb->name, mb->type,
+                   (int)(start - (Instruction*)mb->code),
+                   (int)(end - (Instruction*)mb->code));
+
+        jam_printf("%14s ", "");
+
+        for(ins = start, len = 0; ins <= end &&
+                                  len < MAX_BLOCK_OPCODES; ins++, len++)
+            jam_printf(" %s", opcodeName(ins->opcode, buff));
+
+        jam_printf(ins <= end ? " ...\n" : "\n");
+    }
+
+    sysFree(sorted);
+
+out:
+    pthread_mutex_unlock(&blocks_lock);
+}
+#endif
+
+static int compareOpcodes(const void *pntr1, const void *pntr2) {
+    unsigned long long count1 = stats.opcodes[*(int*)pntr1];
+    unsigned long long count2 = stats.opcodes[*(int*)pntr2];
+
+    return count1 < count2 ? 1 : count1 > count2 ? -1 : 0;
+}
+
+static int comparePairs(const void *pntr1, const void *pntr2) {
+    unsigned long long count1 = ((PairCount*)pntr1)->count;
+    unsigned long long count2 = ((PairCount*)pntr2)->count;
+
+    return count1 < count2 ? 1 : count1 > count2 ? -1 : 0;
+}
+
+void shutdownOpcodeStats() {
+    unsigned long long total = 0;
+    int opcodes[256];
+    PairCount *pairs;
+    char buff1[16], buff2[16];
+    int i, j, count;
+
+    if(!report_size)
+        return;
+
+    for(i = 0; i < 256; i++) {
+        total += stats.opcodes[i];
+        opcodes[i] = i;
+    }
+
+    if(total == 0)
+        return;
+
+    qsort(opcodes, 256, sizeof(int), compareOpcodes);
+
+    jam_printf("\n------ JamVM Opcode Statistics -------\n");
+    jam_printf("Opcodes executed: %llu\n", total);
+
+    jam_printf("\nOpcodes:\n");
+    for(i = 0; i < 256 && i < report_size &&
+               stats.opcodes[opcodes[i]] != 0; i++)
+        jam_printf("%14llu %6.2f%%  %s\n", stats.opcodes[opcodes[i]],
+                   stats.opcodes[opcodes[i]] * 100.0 / total,
+                   opcodeName(opcodes[i], buff1));
+
+    for(count = i = 0; i < 256; i++)
+        for(j = 0; j < 256; j++)
+            if(stats.pairs[i][j] != 0)
+                count++;
+
+    pairs = sysMalloc(count * sizeof(PairCount));
+
+    for(count = i = 0; i < 256; i++)
+        for(j = 0; j < 256; j++)
+            if(stats.pairs[i][j] != 0) {
+                pairs[count].count = stats.pairs[i][j];
+                pairs[count].first = i;
+                pairs[count++].second = j;
+            }
+
+    qsort(pairs, count, sizeof(PairCount), comparePairs);
+
+    jam_printf("\nOpcode pairs:\n");
+    for(i = 0; i < count && i < report_size; i++)
+        jam_printf("%14llu %6.2f%%  %s %s\n", pairs[i].count,
+                   pairs[i].count * 100.0 / total,
+                   opcodeName(pairs[i].first, buff1),
+                   opcodeName(pairs[i].second, buff2));
+
+    sysFree(pairs);
+
+#ifdef INLINING
+    printBlocks();
+#endif
+}
+
+int initialiseOpcodeStats(InitArgs *args) {
+    report_size = args->opcode_stats_report;
+    return TRUE;
+}
+#endif
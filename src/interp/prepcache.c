@@ -0,0 +1,738 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Must be included first to get configure options */
+#include "jam.h"
+
+#ifdef PREPARE_CACHE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "interp.h"
+
+/* Prepared-code cache.  Enabled with -Xprepcache:<file>, the prepared
+   code of each method is saved at exit, and on later runs prepare
+   loads the method's code from the cache instead of converting the
+   bytecode.  The cache file is mapped, and is only read.  New methods
+   are added by writing a new file at exit, which replaces the old.
+
+   A method's entry is keyed by a hash of its class's class file and
+   its index within the class.  The instructions are saved relative
+   to the interpreter: handlers as the opcode (and stack-cache level)
+   whose handler it is, branch targets as instruction indexes, and
+   switch tables as data following the instructions.  The file is
+   only used by the same VM build, which is checked by comparing a
+   fingerprint of the layout of the interpreter's handlers.
+
+   Prepared code which depends on another class (the field offsets
+   of the getfield_this instructions, including superinstructions
+   starting with one) is saved as the constant pool index, and
+   resolved when the method is loaded.  Entries for old
+   versions of classes stay in the cache until it is deleted */
+
+#define CACHE_MAGIC "JamPrep1"
+
+#ifdef USE_CACHE
+#define LEVELS 3
+#else
+#define LEVELS 1
+#endif
+
+#define OPERAND_VALUE         0
+#define OPERAND_BRANCH        1
+#define OPERAND_TABLESWITCH   2
+#define OPERAND_LOOKUPSWITCH  3
+#define OPERAND_FIELD_THIS    4
+
+typedef struct cache_header {
+    char magic[8];
+    u8 fingerprint;
+    u4 entries;
+    u4 pad;
+} CacheHeader;
+
+/* An entry is followed by its instructions, the switch table data
+   (ints), the exception table (start, end and handler for each entry)
+   and the line number table starts.  The size is a multiple of 8 */
+
+typedef struct cache_method {
+    u8 class_hash;
+    u4 method_idx;
+    u4 bytecode_len;
+    u4 ins_count;
+    u4 data_len;
+    u2 exception_table_size;
+    u2 line_no_table_size;
+    u4 size;
+} CacheMethod;
+
+typedef struct cached_ins {
+    u2 handler;
+    u2 kind;
+    u4 data;
+    u8 operand;
+} CachedIns;
+
+typedef struct new_method {
+    struct new_method *next;
+    CacheMethod method;
+} NewMethod;
+
+typedef struct handler_entry {
+    const void *handler;
+    int index;
+} HandlerEntry;
+
+static char *cache_file = NULL;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The mapped cache file, and a hash table of its entries */
+static char *mapped = NULL;
+static size_t mapped_size;
+static CacheMethod **index_table = NULL;
+static int index_size = 0;
+
+/* Entries for methods prepared during this run */
+static NewMethod *new_methods = NULL;
+static int new_entries = 0;
+
+static volatile int build_checked = FALSE;
+static u8 fingerprint;
+static HandlerEntry handler_map[LEVELS * 256];
+
+u8 prepareCacheHash(char *data, int len) {
+    u8 hash = 14695981039346656037ULL;
+    int i;
+
+    /* Zero is used for classes which aren't cached */
+    if(cache_file == NULL)
+        return 0;
+
+    for(i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+
+    return hash == 0 ? 1 : hash;
+}
+
+static int indexHash(u8 class_hash, int method_idx) {
+    return (int)(class_hash ^ (class_hash >> 32)) + method_idx * 31;
+}
+
+static CacheMethod *findEntry(u8 class_hash, int method_idx) {
+    int i;
+
+    if(index_size == 0)
+        return NULL;
+
+    for(i = indexHash(class_hash, method_idx) & (index_size - 1);
+        index_table[i] != NULL; i = (i + 1) & (index_size - 1))
+        if(index_table[i]->class_hash == class_hash &&
+                index_table[i]->method_idx == method_idx)
+            return index_table[i];
+
+    return NULL;
+}
+
+#define INS(method)  ((CachedIns*)((method) + 1))
+#define DATA(method) ((int*)(INS(method) + (method)->ins_count))
+#define EXCEPTIONS(method) ((u2*)(DATA(method) + (method)->data_len))
+#define LINES(method) (EXCEPTIONS(method) + \
+                       (method)->exception_table_size * 3)
+
+static u4 methodSize(int ins_count, int data_len, int exceptions,
+                     int lines) {
+    u4 size = sizeof(CacheMethod) + ins_count * sizeof(CachedIns) +
+              data_len * sizeof(int) + (exceptions * 3 + lines) * sizeof(u2);
+
+    return (size + 7) & ~7;
+}
+
+static int compareHandlers(const void *pntr1, const void *pntr2) {
+    const void *handler1 = ((HandlerEntry*)pntr1)->handler;
+    const void *handler2 = ((HandlerEntry*)pntr2)->handler;
+
+    return handler1 < handler2 ? -1 : handler1 > handler2;
+}
+
+/* The handlers are only known when a method is first prepared.  The
+   handler layout is checked against the cache file, and the table
+   mapping handlers back to opcodes is built */
+
+static void checkBuild(const void ***handlers) {
+    int i;
+
+    if(build_checked)
+        return;
+
+    pthread_mutex_lock(&cache_lock);
+
+    if(!build_checked) {
+        fingerprint = prepareCacheHash((char*)&(u4){sizeof(Instruction)},
+                                       sizeof(u4));
+
+        for(i = 0; i < LEVELS * 256; i++) {
+            const void *handler = handlers[i / 256][i % 256];
+            uintptr_t offset = (char*)handler - (char*)handlers[0][0];
+
+            fingerprint = (fingerprint ^ offset) * 1099511628211ULL;
+            handler_map[i].handler = handler;
+            handler_map[i].index = i;
+        }
+
+        qsort(handler_map, LEVELS * 256, sizeof(HandlerEntry),
+              compareHandlers);
+
+        if(mapped != NULL &&
+                ((CacheHeader*)mapped)->fingerprint != fingerprint) {
+            jam_fprintf(stderr, "Prepared code cache %s is from a different"
+                                " VM build; ignoring it\n", cache_file);
+            index_size = 0;
+        }
+
+        MBARRIER();
+        build_checked = TRUE;
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static int handlerIndex(const void *handler) {
+    HandlerEntry key, *entry;
+
+    key.handler = handler;
+    entry = bsearch(&key, handler_map, LEVELS * 256, sizeof(HandlerEntry),
+                    compareHandlers);
+
+    return entry == NULL ? -1 : entry->index;
+}
+
+/* A superinstruction keeps the operand of the first instruction of
+   its sequence, so its operand is saved as that opcode's would be */
+
+static int operandOpcode(int opcode) {
+#ifdef SUPER_INSNS
+    return superInsnFirstOpcode(opcode);
+#else
+    return opcode;
+#endif
+}
+
+static int operandKind(int opcode) {
+    switch(operandOpcode(opcode)) {
+        case OPC_IFEQ: case OPC_IFNE: case OPC_IFLT: case OPC_IFGE:
+        case OPC_IFGT: case OPC_IFLE: case OPC_IF_ICMPEQ:
+        case OPC_IF_ICMPNE: case OPC_IF_ICMPLT: case OPC_IF_ICMPGE:
+        case OPC_IF_ICMPGT: case OPC_IF_ICMPLE: case OPC_IF_ACMPEQ:
+        case OPC_IF_ACMPNE: case OPC_IFNULL: case OPC_IFNONNULL:
+        case OPC_GOTO: case OPC_JSR:
+            return OPERAND_BRANCH;
+
+        case OPC_TABLESWITCH:
+            return OPERAND_TABLESWITCH;
+
+        case OPC_LOOKUPSWITCH:
+            return OPERAND_LOOKUPSWITCH;
+
+        case OPC_GETFIELD_THIS: case OPC_GETFIELD_THIS_REF:
+            return OPERAND_FIELD_THIS;
+
+        default:
+            return OPERAND_VALUE;
+    }
+}
+
+static MethodBlock *checkMethod(MethodBlock *mb) {
+    ClassBlock *cb = CLASS_CB(mb->class);
+
+    /* Miranda methods aren't in the class's method table, and
+       classes not defined from a class file have no hash */
+    if(cb->file_hash == 0 || mb < cb->methods ||
+                             mb >= cb->methods + cb->methods_count)
+        return NULL;
+
+    return mb;
+}
+
+/* Load a method's prepared code from the cache.  Returns FALSE if the
+   method isn't in the cache (or the entry can't be used), in which
+   case nothing has been changed */
+
+int prepareCacheLoad(MethodBlock *mb, const void ***handlers,
+                     Instruction **code_pntr, int *ins_count_pntr) {
+    ClassBlock *cb = CLASS_CB(mb->class);
+    Instruction *new_code;
+    CacheMethod *method;
+    CachedIns *ins;
+    int *data;
+    u2 *table;
+    int i, j;
+
+    if(cache_file == NULL || checkMethod(mb) == NULL)
+        return FALSE;
+
+    checkBuild(handlers);
+
+    method = findEntry(cb->file_hash, mb - cb->methods);
+
+    if(method == NULL || method->bytecode_len != mb->code_size ||
+            method->exception_table_size != mb->exception_table_size ||
+            method->line_no_table_size != mb->line_no_table_size)
+        return FALSE;
+
+    ins = INS(method);
+    data = DATA(method);
+    new_code = sysMalloc((method->ins_count + 1) * sizeof(Instruction));
+
+    /* Check and relocate the instructions.  The switch
+       tables are only allocated once everything is checked */
+
+    for(i = 0; i < method->ins_count; i++) {
+        int level = ins[i].handler >> 8;
+        u4 ins_data = ins[i].data;
+        FieldBlock *fb;
+
+        /* The kind must be the one the handler's operand has */
+        if(level >= LEVELS ||
+                ins[i].kind != operandKind(ins[i].handler & 0xff))
+            goto error;
+
+        new_code[i].handler = handlers[level][ins[i].handler & 0xff];
+
+        switch(ins[i].kind) {
+            case OPERAND_VALUE:
+                memcpy(&new_code[i].operand, &ins[i].operand,
+                       sizeof(Operand));
+                break;
+
+            case OPERAND_BRANCH:
+                if(ins_data >= method->ins_count)
+                    goto error;
+
+                new_code[i].operand.pntr = &new_code[ins_data];
+                break;
+
+            case OPERAND_TABLESWITCH:
+                if(ins_data + 3 > method->data_len ||
+                        data[ins_data + 1] < data[ins_data] ||
+                        ins_data + 3 + (u4)(data[ins_data + 1] -
+                            data[ins_data] + 1) > method->data_len)
+                    goto error;
+
+                for(j = 2; j < data[ins_data + 1] - data[ins_data] + 4; j++)
+                    if((u4)data[ins_data + j] >= method->ins_count)
+                        goto error;
+                break;
+
+            case OPERAND_LOOKUPSWITCH:
+                if(ins_data + 2 > method->data_len || data[ins_data] < 0 ||
+                        ins_data + 2 + (u4)data[ins_data] * 2 >
+                            method->data_len)
+                    goto error;
+
+                for(j = 0; j < data[ins_data]; j++)
+                    if((u4)data[ins_data + 3 + j * 2] >= method->ins_count)
+                        goto error;
+
+                if((u4)data[ins_data + 1] >= method->ins_count)
+                    goto error;
+                break;
+
+            case OPERAND_FIELD_THIS:
+                fb = resolveField(mb->class, ins_data);
+
+                if(fb == NULL || *fb->type == 'J' || *fb->type == 'D' ||
+                        operandOpcode(ins[i].handler & 0xff) !=
+                            (*fb->type == 'L' || *fb->type == '['
+                                ? OPC_GETFIELD_THIS_REF
+                                : OPC_GETFIELD_THIS))
+                    goto error;
+
+                new_code[i].operand.i = fb->u.offset;
+                break;
+
+            default:
+                goto error;
+        }
+    }
+
+    for(i = 0; i < method->ins_count; i++) {
+        u4 ins_data = ins[i].data;
+
+        if(ins[i].kind == OPERAND_TABLESWITCH) {
+            SwitchTable *table = sysMalloc(sizeof(SwitchTable));
+            int size = data[ins_data + 1] - data[ins_data] + 1;
+
+            table->low = data[ins_data];
+            table->high = data[ins_data + 1];
+            table->deflt = &new_code[data[ins_data + 2]];
+            table->entries = sysMalloc(size * sizeof(Instruction *));
+
+            for(j = 0; j < size; j++)
+                table->entries[j] = &new_code[data[ins_data + 3 + j]];
+
+            new_code[i].operand.pntr = table;
+
+        } else if(ins[i].kind == OPERAND_LOOKUPSWITCH) {
+            LookupTable *table = sysMalloc(sizeof(LookupTable));
+            int npairs = data[ins_data];
+
+            table->num_entries = npairs;
+            table->deflt = &new_code[data[ins_data + 1]];
+            table->entries = sysMalloc(npairs * sizeof(LookupEntry));
+
+            for(j = 0; j < npairs; j++) {
+                table->entries[j].key = data[ins_data + 2 + j * 2];
+                table->entries[j].handler =
+                        &new_code[data[ins_data + 3 + j * 2]];
+            }
+
+            new_code[i].operand.pntr = table;
+        }
+    }
+
+    /* Update the method's line number and exception tables */
+
+    table = EXCEPTIONS(method);
+    for(i = 0; i < mb->exception_table_size; i++) {
+        ExceptionTableEntry *entry = &mb->exception_table[i];
+        entry->start_pc = *table++;
+        entry->end_pc = *table++;
+        entry->handler_pc = *table++;
+    }
+
+    for(i = 0; i < mb->line_no_table_size; i++)
+        mb->line_no_table[i].start_pc = *table++;
+
+    *code_pntr = new_code;
+    *ins_count_pntr = method->ins_count;
+    return TRUE;
+
+error:
+    sysFree(new_code);
+    return FALSE;
+}
+
+/* Save a newly prepared method.  This is called before the method's
+   code is published, so the instructions are unquickened */
+
+void prepareCacheSave(MethodBlock *mb, Instruction *new_code, int ins_count,
+                      unsigned char *code, short *map,
+                      const void ***handlers) {
+    ClassBlock *cb = CLASS_CB(mb->class);
+    int ins_pc[ins_count];
+    int data_len = 0;
+    NewMethod *new;
+    CacheMethod *method;
+    CachedIns *ins;
+    u2 *table;
+    int *data;
+    int i, j;
+
+    if(cache_file == NULL || checkMethod(mb) == NULL)
+        return;
+
+    checkBuild(handlers);
+
+    /* Map the instructions back to their bytecode, and
+       find the size of the switch tables */
+
+    for(i = 0; i < ins_count; i++)
+        ins_pc[i] = -1;
+
+    for(i = 0; i < mb->code_size; i++)
+        if(map[i] >= 0 && map[i] < ins_count)
+            ins_pc[map[i]] = i;
+
+    for(i = 0; i < ins_count; i++) {
+        int index = handlerIndex(new_code[i].handler);
+
+        if(index == -1)
+            return;
+
+        switch(operandKind(index & 0xff)) {
+            case OPERAND_TABLESWITCH: {
+                SwitchTable *table = new_code[i].operand.pntr;
+                data_len += table->high - table->low + 4;
+                break;
+            }
+
+            case OPERAND_LOOKUPSWITCH:
+                data_len += ((LookupTable*)new_code[i].operand.pntr)->
+                                num_entries * 2 + 2;
+                break;
+
+            case OPERAND_FIELD_THIS:
+                if(ins_pc[i] == -1 || code[ins_pc[i]] != OPC_ALOAD_0 ||
+                                      code[ins_pc[i] + 1] != OPC_GETFIELD)
+                    return;
+                break;
+        }
+    }
+
+    new = sysMalloc(sizeof(NewMethod) - sizeof(CacheMethod) +
+                    methodSize(ins_count, data_len, mb->exception_table_size,
+                               mb->line_no_table_size));
+    method = &new->method;
+
+    method->class_hash = cb->file_hash;
+    method->method_idx = mb - cb->methods;
+    method->bytecode_len = mb->code_size;
+    method->ins_count = ins_count;
+    method->data_len = data_len;
+    method->exception_table_size = mb->exception_table_size;
+    method->line_no_table_size = mb->line_no_table_size;
+    method->size = methodSize(ins_count, data_len, mb->exception_table_size,
+                              mb->line_no_table_size);
+
+    ins = INS(method);
+    data = DATA(method);
+
+    for(data_len = i = 0; i < ins_count; i++) {
+        int index = handlerIndex(new_code[i].handler);
+        Operand *operand = &new_code[i].operand;
+
+        ins[i].handler = index;
+        ins[i].kind = operandKind(index & 0xff);
+        ins[i].data = 0;
+        ins[i].operand = 0;
+
+        switch(ins[i].kind) {
+            case OPERAND_VALUE:
+                memcpy(&ins[i].operand, operand, sizeof(Operand));
+                break;
+
+            case OPERAND_BRANCH:
+                ins[i].data = (Instruction*)operand->pntr - new_code;
+                break;
+
+            case OPERAND_TABLESWITCH: {
+                SwitchTable *table = operand->pntr;
+
+                ins[i].data = data_len;
+                data[data_len++] = table->low;
+                data[data_len++] = table->high;
+                data[data_len++] = table->deflt - new_code;
+
+                for(j = 0; j <= table->high - table->low; j++)
+                    data[data_len++] = table->entries[j] - new_code;
+                break;
+            }
+
+            case OPERAND_LOOKUPSWITCH: {
+                LookupTable *table = operand->pntr;
+
+                ins[i].data = data_len;
+                data[data_len++] = table->num_entries;
+                data[data_len++] = table->deflt - new_code;
+
+                for(j = 0; j < table->num_entries; j++) {
+                    data[data_len++] = table->entries[j].key;
+                    data[data_len++] = table->entries[j].handler - new_code;
+                }
+                break;
+            }
+
+            case OPERAND_FIELD_THIS:
+                ins[i].data = READ_U2_OP(code + ins_pc[i] + 1);
+                break;
+        }
+    }
+
+    table = EXCEPTIONS(method);
+    for(i = 0; i < mb->exception_table_size; i++) {
+        ExceptionTableEntry *entry = &mb->exception_table[i];
+        *table++ = entry->start_pc;
+        *table++ = entry->end_pc;
+        *table++ = entry->handler_pc;
+    }
+
+    for(i = 0; i < mb->line_no_table_size; i++)
+        *table++ = mb->line_no_table[i].start_pc;
+
+    pthread_mutex_lock(&cache_lock);
+
+    new->next = new_methods;
+    new_methods = new;
+    new_entries++;
+
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static int writeEntry(FILE *file, CacheMethod *method) {
+    return fwrite(method, method->size, 1, file) == 1;
+}
+
+/* Write the old entries and the new entries to a new file, which
+   replaces the old file (another VM may still be using it).  A method
+   only has a new entry if its old entry couldn't be used, so the old
+   entry is dropped */
+
+void shutdownPrepareCache() {
+    char tmp_name[strlen(cache_file == NULL ? "" : cache_file) + 16];
+    char *replaced = NULL;
+    int entries = new_entries;
+    CacheHeader header;
+    NewMethod *new;
+    int ok, i;
+    FILE *file;
+
+    if(cache_file == NULL)
+        return;
+
+    pthread_mutex_lock(&cache_lock);
+
+    if(new_entries == 0)
+        goto out;
+
+    sprintf(tmp_name, "%s.%d", cache_file, getpid());
+
+    if((file = fopen(tmp_name, "w")) == NULL) {
+        jam_fprintf(stderr, "Couldn't open prepared code cache %s\n",
+                    tmp_name);
+        goto out;
+    }
+
+    if(index_size != 0) {
+        replaced = sysMalloc(index_size);
+        memset(replaced, FALSE, index_size);
+    }
+
+    for(new = new_methods; new != NULL && index_size != 0; new = new->next)
+        for(i = indexHash(new->method.class_hash, new->method.method_idx) &
+                (index_size - 1);
+            index_table[i] != NULL; i = (i + 1) & (index_size - 1))
+            if(index_table[i]->class_hash == new->method.class_hash &&
+                    index_table[i]->method_idx == new->method.method_idx)
+                replaced[i] = TRUE;
+
+    for(i = 0; i < index_size; i++)
+        if(index_table[i] != NULL && !replaced[i])
+            entries++;
+
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.fingerprint = fingerprint;
+    header.entries = entries;
+    header.pad = 0;
+
+    ok = fwrite(&header, sizeof(CacheHeader), 1, file) == 1;
+
+    for(i = 0; ok && i < index_size; i++)
+        if(index_table[i] != NULL && !replaced[i])
+            ok = writeEntry(file, index_table[i]);
+
+    sysFree(replaced);
+
+    for(new = new_methods; ok && new != NULL; new = new->next)
+        ok = writeEntry(file, &new->method);
+
+    if(fclose(file) != 0 || !ok || rename(tmp_name, cache_file) != 0) {
+        jam_fprintf(stderr, "Couldn't write prepared code cache %s\n",
+                    cache_file);
+        unlink(tmp_name);
+    }
+
+out:
+    /* Methods prepared from now on aren't saved */
+    cache_file = NULL;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/* Map the cache file (if it exists) and index its entries */
+
+static void mapCacheFile() {
+    CacheHeader *header;
+    struct stat info;
+    size_t offset;
+    int fd, i;
+
+    if((fd = open(cache_file, O_RDONLY)) == -1)
+        return;
+
+    if(fstat(fd, &info) != 0 || info.st_size < sizeof(CacheHeader))
+        goto error;
+
+    mapped_size = info.st_size;
+    mapped = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(mapped == MAP_FAILED) {
+        mapped = NULL;
+        return;
+    }
+
+    header = (CacheHeader*)mapped;
+    if(memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0)
+        goto invalid;
+
+    for(index_size = 16; index_size < header->entries * 2; index_size <<= 1);
+    index_table = sysMalloc(index_size * sizeof(CacheMethod*));
+    memset(index_table, 0, index_size * sizeof(CacheMethod*));
+
+    offset = sizeof(CacheHeader);
+    for(i = 0; i < header->entries; i++) {
+        CacheMethod *method = (CacheMethod*)(mapped + offset);
+        int idx;
+
+        if(offset + sizeof(CacheMethod) > mapped_size ||
+                method->size < sizeof(CacheMethod) ||
+                method->size != methodSize(method->ins_count,
+                                           method->data_len,
+                                           method->exception_table_size,
+                                           method->line_no_table_size) ||
+                offset + method->size > mapped_size)
+            goto invalid;
+
+        for(idx = indexHash(method->class_hash, method->method_idx) &
+                  (index_size - 1);
+            index_table[idx] != NULL; idx = (idx + 1) & (index_size - 1));
+
+        index_table[idx] = method;
+        offset += method->size;
+    }
+
+    return;
+
+invalid:
+    jam_fprintf(stderr, "Prepared code cache %s is invalid; ignoring it\n",
+                cache_file);
+    sysFree(index_table);
+    index_table = NULL;
+    index_size = 0;
+    munmap(mapped, mapped_size);
+    mapped = NULL;
+    return;
+
+error:
+    close(fd);
+}
+
+int initialisePrepareCache(InitArgs *args) {
+    if((cache_file = args->prepare_cache) != NULL)
+        mapCacheFile();
+
+    return TRUE;
+}
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Intrinsics are native implementations of commonly called library
+   methods.  The registry is consulted when a class is linked, and
+   calls to a method with an intrinsic are performed inline by the
+   interpreter (see isTrivialMethod).  The method itself is unchanged,
+   so reflection, JNI and stack traces see the original method.
+
+   An intrinsic is called with the arguments on the operand stack,
+   but without a frame.  It must not allocate or throw exceptions.
+   Instead, if it can't handle the arguments (e.g. a null array) it
+   returns NULL, and the method is invoked normally.  Otherwise it
+   returns the operand stack after pushing any result. */
+
+#include <string.h>
+
+#include "jam.h"
+#include "natives.h"
+
+static int enabled;
+
+/* java.lang.Math */
+
+static uintptr_t *minI(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    int a = ostack[0];
+    int b = ostack[1];
+
+    *ostack++ = a < b ? a : b;
+    return ostack;
+}
+
+static uintptr_t *maxI(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    int a = ostack[0];
+    int b = ostack[1];
+
+    *ostack++ = a > b ? a : b;
+    return ostack;
+}
+
+static uintptr_t *absI(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    int a = ostack[0];
+
+    /* Negate unsigned, so MIN_VALUE wraps as in Java */
+    *ostack++ = a < 0 ? (int)-(unsigned int)a : a;
+    return ostack;
+}
+
+static uintptr_t *minJ(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    long long a = *(long long*)&ostack[0];
+    long long b = *(long long*)&ostack[2];
+
+    *(long long*)ostack = a < b ? a : b;
+    return ostack + 2;
+}
+
+static uintptr_t *maxJ(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    long long a = *(long long*)&ostack[0];
+    long long b = *(long long*)&ostack[2];
+
+    *(long long*)ostack = a > b ? a : b;
+    return ostack + 2;
+}
+
+static uintptr_t *absJ(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    long long a = *(long long*)&ostack[0];
+
+    *(long long*)ostack = a < 0 ? (long long)-(unsigned long long)a : a;
+    return ostack + 2;
+}
+
+/* java.lang.Integer and java.lang.Long */
+
+static uintptr_t *bitCountI(Class *class, MethodBlock *mb,
+                            uintptr_t *ostack) {
+
+    *ostack = __builtin_popcount((unsigned int)ostack[0]);
+    return ostack + 1;
+}
+
+static uintptr_t *bitCountJ(Class *class, MethodBlock *mb,
+                            uintptr_t *ostack) {
+
+    *ostack = __builtin_popcountll(*(unsigned long long*)&ostack[0]);
+    return ostack + 1;
+}
+
+static uintptr_t *numberOfLeadingZerosI(Class *class, MethodBlock *mb,
+                                        uintptr_t *ostack) {
+    unsigned int i = ostack[0];
+
+    *ostack = i == 0 ? 32 : __builtin_clz(i);
+    return ostack + 1;
+}
+
+static uintptr_t *numberOfTrailingZerosI(Class *class, MethodBlock *mb,
+                                         uintptr_t *ostack) {
+    unsigned int i = ostack[0];
+
+    *ostack = i == 0 ? 32 : __builtin_ctz(i);
+    return ostack + 1;
+}
+
+/* java.util.Arrays.fill.  The loops are simple enough for the
+   compiler to vectorise, and memset is used for byte arrays */
+
+static uintptr_t *fillB(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *array = (Object*)ostack[0];
+
+    if(array == NULL)
+        return NULL;
+
+    memset(ARRAY_DATA(array, char), (char)ostack[1], ARRAY_LEN(array));
+    return ostack;
+}
+
+static uintptr_t *fillC(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *array = (Object*)ostack[0];
+    unsigned short value = ostack[1];
+    unsigned short *data;
+    int i, len;
+
+    if(array == NULL)
+        return NULL;
+
+    data = ARRAY_DATA(array, unsigned short);
+    for(i = 0, len = ARRAY_LEN(array); i < len; i++)
+        data[i] = value;
+
+    return ostack;
+}
+
+static uintptr_t *fillI(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *array = (Object*)ostack[0];
+    int value = ostack[1];
+    int *data;
+    int i, len;
+
+    if(array == NULL)
+        return NULL;
+
+    data = ARRAY_DATA(array, int);
+    for(i = 0, len = ARRAY_LEN(array); i < len; i++)
+        data[i] = value;
+
+    return ostack;
+}
+
+static uintptr_t *fillJ(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *array = (Object*)ostack[0];
+    long long value = *(long long*)&ostack[1];
+    long long *data;
+    int i, len;
+
+    if(array == NULL)
+        return NULL;
+
+    data = ARRAY_DATA(array, long long);
+    for(i = 0, len = ARRAY_LEN(array); i < len; i++)
+        data[i] = value;
+
+    return ostack;
+}
+
+static uintptr_t *fillL(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *array = (Object*)ostack[0];
+    Object *value = (Object*)ostack[1];
+    Object **data;
+    int i, len;
+
+    /* Leave the ArrayStoreException to the bytecode */
+    if(array == NULL || (value != NULL &&
+                         !arrayStoreCheck(array->class, value->class)))
+        return NULL;
+
+    data = ARRAY_DATA(array, Object*);
+    for(i = 0, len = ARRAY_LEN(array); i < len; i++)
+        data[i] = value;
+
+    return ostack;
+}
+
+/* java.lang.Object */
+
+static uintptr_t *getClass(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    *ostack = (uintptr_t)((Object*)ostack[0])->class;
+    return ostack + 1;
+}
+
+static VMMethod math[] = {
+    {"min",                   "(II)I", minI},
+    {"max",                   "(II)I", maxI},
+    {"abs",                   "(I)I",  absI},
+    {"min",                   "(JJ)J", minJ},
+    {"max",                   "(JJ)J", maxJ},
+    {"abs",                   "(J)J",  absJ},
+    {NULL,                    NULL,    NULL}
+};
+
+static VMMethod integer[] = {
+    {"bitCount",              "(I)I",  bitCountI},
+    {"numberOfLeadingZeros",  "(I)I",  numberOfLeadingZerosI},
+    {"numberOfTrailingZeros", "(I)I",  numberOfTrailingZerosI},
+    {NULL,                    NULL,    NULL}
+};
+
+static VMMethod long_[] = {
+    {"bitCount",              "(J)I",  bitCountJ},
+    {NULL,                    NULL,    NULL}
+};
+
+static VMMethod string[] = {
+    {"equals",                "(Ljava/lang/Object;)Z", stringEquals},
+    {"hashCode",              "()I",   stringHashCode},
+    {"indexOf",               "(I)I",  stringIndexOf},
+    {NULL,                    NULL,    NULL}
+};
+
+static VMMethod arrays[] = {
+    {"fill",                  "([BB)V", fillB},
+    {"fill",                  "([CC)V", fillC},
+    {"fill",                  "([II)V", fillI},
+    {"fill",                  "([JJ)V", fillJ},
+    {"fill",                  "([Ljava/lang/Object;Ljava/lang/Object;)V",
+                                        fillL},
+    {NULL,                    NULL,     NULL}
+};
+
+static VMMethod object[] = {
+    {"getClass",              "()Ljava/lang/Class;", getClass},
+    {NULL,                    NULL,    NULL}
+};
+
+static VMClass intrinsics[] = {
+    {"java/lang/Math",        math},
+    {"java/lang/StrictMath",  math},
+    {"java/lang/Integer",     integer},
+    {"java/lang/Long",        long_},
+    {"java/lang/String",      string},
+    {"java/util/Arrays",      arrays},
+    {"java/lang/Object",      object},
+    {NULL,                    NULL}
+};
+
+NativeMethod lookupIntrinsic(MethodBlock *mb) {
+    ClassBlock *cb = CLASS_CB(mb->class);
+    int i;
+
+    if(!enabled || mb->access_flags & ACC_SYNCHRONIZED)
+        return NULL;
+
+    for(i = 0; intrinsics[i].classname &&
+        (strcmp(cb->name, intrinsics[i].classname) != 0); i++);
+
+    if(intrinsics[i].classname) {
+        VMMethod *methods = intrinsics[i].methods;
+
+        for(i = 0; methods[i].methodname &&
+            ((strcmp(mb->name, methods[i].methodname) != 0) ||
+             (strcmp(mb->type, methods[i].methodtype) != 0)); i++);
+
+        return methods[i].method;
+    }
+
+    return NULL;
+}
+
+int initialiseIntrinsics(InitArgs *args) {
+    enabled = args->intrinsics;
+    return TRUE;
+}
@@ -52,14 +52,43 @@ void showNonStandardOptions() {
     printf("  -Xasyncgc\t   turn on asynchronous garbage collection\n");
     printf("  -Xcompactalways  always compact the heap when garbage-collecting\n");
     printf("  -Xnocompact\t   turn off heap-compaction\n");
+    printf("  -Xlockprof[:<n>[,<sample>]]\n");
+    printf("\t\t   profile monitor contention, reporting the top n\n");
+    printf("\t\t   sites (default 20) at exit and on SIGQUIT.  Sites\n");
+    printf("\t\t   are recorded every <sample> events (default 1)\n");
+    printf("  -Xprof[:file=<file>][,interval=<us>]\n");
+    printf("\t\t   sample the Java stacks of running threads every\n");
+    printf("\t\t   interval microseconds of CPU time (default 10000)\n");
+    printf("\t\t   and write them at exit to file (default jamvm.prof)\n");
+    printf("\t\t   as collapsed stacks\n");
+    printf("  -Xnointrinsics\t   turn off native implementations of library\n");
+    printf("\t\t   methods\n");
+    printf("  -Xmaxtracedepth:<n>\n");
+    printf("\t\t   capture at most n frames in an exception's stack\n");
+    printf("\t\t   trace (default 0, unlimited)\n");
 #ifdef INLINING
     printf("  -Xnoinlining\t   turn off interpreter inlining\n");
+    printf("  -Xnobackgroundinlining\n");
+    printf("\t\t   inline hot code in the executing thread rather\n");
+    printf("\t\t   than a background thread\n");
     printf("  -Xshowreloc\t   show opcode relocatability\n");
     printf("  -Xreplication:[none|always|<value>]\n");
     printf("\t\t   none : always re-use super-instructions\n");
     printf("\t\t   always : never re-use super-instructions\n");
     printf("\t\t   <value> copy when usage reaches threshold value\n");
     printf("  -Xcodemem:[unlimited|<size>] (default maximum heapsize/4)\n");
+    printf("  -Xperfmap\t   write /tmp/perf-<pid>.map, labelling\n");
+    printf("\t\t   super-instructions for the perf profiler\n");
+#endif
+#ifdef OPCODE_STATS
+    printf("  -Xopcodestats[:<n>]\n");
+    printf("\t\t   count executed opcodes and opcode pairs, reporting\n");
+    printf("\t\t   the top n of each (default 20) at exit\n");
+#endif
+#ifdef PREPARE_CACHE
+    printf("  -Xprepcache:<file>\n");
+    printf("\t\t   load prepared method code from <file>, saving\n");
+    printf("\t\t   newly prepared methods to it at exit\n");
 #endif
     printf("  -Xms<size>\t   set the initial size of the heap\n");
     printf("\t\t   (default = MAX(physical memory/64, %dM))\n",
@@ -69,6 +98,8 @@ void showNonStandardOptions() {
            DEFAULT_MAX_HEAP/MB);
     printf("  -Xss<size>\t   set the Java stack size for each thread "
            "(default = %dK)\n", DEFAULT_STACK/KB);
+    printf("  -Xssmax<size>\t   set the size each thread's Java stack may grow "
+           "to\n\t\t   (default = MAX(-Xss, %dM))\n", DEFAULT_MAX_STACK/MB);
     printf("\t\t   size may be followed by K,k or M,m (e.g. 2M)\n");
 }
 
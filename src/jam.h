@@ -39,6 +39,14 @@
 #define         FALSE   0
 #endif
 
+/* The prepared-code cache saves the code produced by the direct
+   interpreter's prepare.  The inlining interpreter's code depends on
+   runtime profiling, and the debug builds add fields to instructions */
+#if defined(DIRECT) && !defined(INLINING) && !defined(DIRECT_DEBUG) && \
+    !defined(OPCODE_STATS)
+#define PREPARE_CACHE
+#endif
+
 /* These should go in the interpreter file */
 
 #define OPC_NOP                           0
@@ -243,8 +251,10 @@
 #define OPC_IFNONNULL                   199
 #define OPC_GOTO_W                      200
 #define OPC_JSR_W                       201
+#define OPC_SUPER_0                     202
 #define OPC_LDC_QUICK                   203
 #define OPC_LDC_W_QUICK                 204
+#define OPC_SUPER_1                     205
 #define OPC_GETFIELD_QUICK              206
 #define OPC_PUTFIELD_QUICK              207
 #define OPC_GETFIELD2_QUICK             208
@@ -273,9 +283,15 @@
 #define OPC_ALOAD_THIS                  231
 #define OPC_INVOKESTATIC_QUICK          232
 #define OPC_NEW_QUICK                   233
+#define OPC_SUPER_2                     234
 #define OPC_ANEWARRAY_QUICK             235
+#define OPC_SUPER_3                     236
+#define OPC_SUPER_4                     237
 #define OPC_CHECKCAST_QUICK             238
 #define OPC_INSTANCEOF_QUICK            239
+#define OPC_SUPER_5                     240
+#define OPC_SUPER_6                     241
+#define OPC_SUPER_7                     242
 #define OPC_MULTIANEWARRAY_QUICK        243
 #define OPC_INVOKEHANDLE                244
 #define OPC_INVOKEBASIC                 245
@@ -284,6 +300,11 @@
 #define OPC_LINKTOINTERFACE             248
 #define OPC_INVOKEINTERFACE_QUICK       249
 #define OPC_INVOKEDYNAMIC_QUICK         250
+#define OPC_INVOKEVIRTUAL_TRIVIAL       251
+#define OPC_INVOKENONVIRT_TRIVIAL       252
+#define OPC_INVOKESTATIC_TRIVIAL        253
+#define OPC_SUPER_8                     254
+#define OPC_SUPER_9                     255
 
 /* Constant pool tags */
 
@@ -387,13 +408,41 @@
 #define MB_CALLER_SENSITIVE     4
 #define MB_DEFAULT_CONFLICT     8
 
-/* Method states (direct or inlining
-   interpreter variants) */
+/* Trivial method kinds.  Calls to trivial methods are
+   performed inline by the interpreter.  The getter, setter
+   and init kinds have not yet had their field or method
+   reference resolved (see isTrivialMethod).  Intrinsic
+   methods have a native implementation (see intrinsics.c) */
+
+#define TRIVIAL_GETFIELD        1
+#define TRIVIAL_GETFIELD_REF    2
+#define TRIVIAL_GETFIELD2       3
+#define TRIVIAL_PUTFIELD        4
+#define TRIVIAL_PUTFIELD_REF    5
+#define TRIVIAL_PUTFIELD2       6
+#define TRIVIAL_CONSTANT        7
+#define TRIVIAL_EMPTY           8
+#define TRIVIAL_GETTER          9
+#define TRIVIAL_SETTER          10
+#define TRIVIAL_INIT            11
+#define TRIVIAL_INTRINSIC       12
+
+/* Method states (direct or inlining interpreter variants).
+   The state is a full word, as prepare claims a method by
+   compare-and-swap of unprepared to preparing */
 
 #define MB_UNPREPARED           0
 #define MB_PREPARING            1
 #define MB_PREPARED             2
 
+/* Method entry kinds.  These are selected when the method
+   is linked or prepared, and let invokes skip the checks
+   for a synchronized, native or unprepared method */
+
+#define ENTRY_GENERIC           0
+#define ENTRY_INTERPRETED       1
+#define ENTRY_NATIVE            2
+
 typedef unsigned char          u1;
 typedef unsigned short         u2;
 typedef unsigned int           u4;
@@ -470,10 +519,15 @@ typedef union ins_operand {
 } Operand;
 
 typedef struct instruction {
-#ifdef DIRECT_DEBUG
+#if defined(DIRECT_DEBUG) || defined(OPCODE_STATS)
     unsigned char opcode;
+#endif
+#ifdef DIRECT_DEBUG
     char cache_depth;
     short bytecode_pc;
+#endif
+#ifdef OPCODE_STATS
+    uintptr_t count;
 #endif
     const void *handler;
     Operand operand;
@@ -497,6 +551,26 @@ typedef struct lookup_table {
     LookupEntry *entries;
 } LookupTable;
 
+/* Polymorphic inline cache for an invokeinterface call site.  Holds
+   up to INTF_CACHE_SIZE receiver class -> method pairs.  Once full,
+   further receiver classes are looked up in the imethod table, using
+   the last index found as a hint */
+#define INTF_CACHE_SIZE 4
+
+typedef struct intf_cache_entry {
+    Class *class;
+    struct methodblock *mb;
+} InterfaceCacheEntry;
+
+typedef struct interface_cache {
+    struct methodblock *imethod;
+    struct methodblock *owner;
+    int imethod_table_hint;
+    uintptr_t count;
+    InterfaceCacheEntry entries[INTF_CACHE_SIZE];
+    struct interface_cache *next;
+} InterfaceCache;
+
 #ifdef INLINING
 typedef struct opcode_info {
     unsigned char opcode;
@@ -504,6 +578,7 @@ typedef struct opcode_info {
 } OpcodeInfo;
 
 typedef struct profile_info ProfileInfo;
+typedef struct inlined_code InlinedCode;
 
 typedef struct basic_block {
     union {
@@ -537,6 +612,7 @@ typedef struct prepare_info {
 struct profile_info {
     BasicBlock *block;
     int profile_count;
+    int queued;
     const void *handler;
     struct profile_info *next;
     struct profile_info *prev;
@@ -556,13 +632,16 @@ struct methodblock {
    char *name;
    char *type;
    char *signature;
-   u1 state;
+   u4 state;
    u1 flags;
    u2 access_flags;
    u2 max_stack;
    u2 max_locals;
    u2 args_count;
    u2 throw_table_size;
+   u1 trivial;
+   u1 entry;
+   u2 trivial_index;
    u2 *throw_table;
    void *code;
    int code_size;
@@ -591,9 +670,12 @@ struct methodblock {
        };
    };
    int method_table_index;
+   int trivial_operand;
+   NativeMethod intrinsic;
 #ifdef INLINING
    QuickPrepareInfo *quick_prepare_info;
    ProfileInfo *profile_info;
+   InlinedCode *inlined_code;
 #endif
 };
 
@@ -652,6 +734,14 @@ typedef struct refs_offsets_entry {
     int end;
 } RefsOffsetsEntry;
 
+/* Linked classes hold a display of their superclasses, indexed by
+   depth in the class hierarchy (Object is 0), giving a constant-time
+   subclass test.  Superclasses deeper than the display, and all
+   implemented interfaces, are held in the secondary supers array */
+#ifndef PRIMARY_SUPERS_DEPTH
+#define PRIMARY_SUPERS_DEPTH 8
+#endif
+
 typedef struct classblock {
    CLASSLIB_CLASS_PAD
    u1 state;
@@ -669,6 +759,10 @@ typedef struct classblock {
    int object_size;
    int method_table_size;
    int imethod_table_size;
+   int imethod_hash_size;
+   int interface_id;
+   int super_depth;
+   int secondary_supers_count;
    int initing_tid;
    union {
        struct {
@@ -691,9 +785,16 @@ typedef struct classblock {
    Class **interfaces;
    MethodBlock **method_table;
    ITableEntry *imethod_table;
+   int *imethod_hash;
+   Class *primary_supers[PRIMARY_SUPERS_DEPTH];
+   Class **secondary_supers;
+   Class *secondary_super_cache;
    char *bootstrap_methods;
    ExtraAttributes *extra_attributes;
    ConstantPool constant_pool;
+#ifdef PREPARE_CACHE
+   u8 file_hash;
+#endif
    CLASSLIB_CLASS_EXTRA_FIELDS
 } ClassBlock;
 
@@ -713,14 +814,54 @@ typedef struct jni_frame {
    struct frame *prev;
 } JNIFrame;
 
+/* Number of frames in a stack trace which are captured
+   in a single walk of the stack (see stackTrace) */
+#ifndef TRACE_BUFFER_DEPTH
+#define TRACE_BUFFER_DEPTH 64
+#endif
+
+/* Each thread caches the result of exception handler lookups,
+   keyed by the throwing pc and the exception's class (see
+   findCatchBlock).  Must be a power of 2 */
+#ifndef CATCH_CACHE_SIZE
+#define CATCH_CACHE_SIZE 32
+#endif
+
+typedef struct catch_cache_entry {
+    CodePntr pc;
+    MethodBlock *mb;
+    Class *exception;
+    CodePntr handler;
+    int epoch;
+} CatchCacheEntry;
+
+/* Implicit checks let an access fault instead of testing for the
+   error, and the SIGSEGV handler returns to the interpreter to throw
+   the exception.  With implicit null checks, a null reference is
+   dereferenced at an offset below the limit, and faults as the page
+   isn't mapped */
+#if defined(IMPLICIT_NULL_CHECKS) || defined(IMPLICIT_STACK_CHECKS)
+#define IMPLICIT_CHECKS
+#include <setjmp.h>
+#endif
+
+#ifdef IMPLICIT_NULL_CHECKS
+#define IMPLICIT_NULL_LIMIT 4096
+#endif
+
 typedef struct exec_env {
     Object *exception;
     char *stack;
     char *stack_end;
     int stack_size;
+    int stack_max;
     Frame *last_frame;
     Object *thread;
     char overflow;
+    CatchCacheEntry catch_cache[CATCH_CACHE_SIZE];
+#ifdef IMPLICIT_CHECKS
+    sigjmp_buf *implicit_check_env;
+#endif
 } ExecEnv;
 
 typedef struct prop {
@@ -740,6 +881,17 @@ typedef struct InitArgs {
 
     int trace_jni_sigs;
 
+    int lock_profile_report; /* Number of sites reported by the monitor
+                                contention profiler (0 if disabled) */
+    int lock_profile_sample;
+
+    char *prof_file;   /* CPU profile output file, or NULL if disabled */
+    int prof_interval; /* CPU profile sampling interval (microseconds) */
+
+    int intrinsics; /* Whether library intrinsics are enabled */
+
+    int max_trace_depth; /* Maximum frames in an exception's stack trace */
+
     char *classpath;
 
     char *bootpath;
@@ -749,6 +901,7 @@ typedef struct InitArgs {
     char *bootpath_v;
 
     int java_stack;
+    int max_java_stack;
     unsigned long min_heap;
     unsigned long max_heap;
 
@@ -772,11 +925,22 @@ typedef struct InitArgs {
     int print_codestats;
     int join_blocks;
     int profiling;
+    int background_inlining;
+    int perf_map;
 #endif
 
 #ifdef HAVE_PROFILE_STUBS
     int dump_stubs_profiles;
 #endif
+
+#ifdef OPCODE_STATS
+    int opcode_stats_report; /* Number of entries in each ranking of the
+                                opcode statistics, or 0 if disabled */
+#endif
+
+#ifdef PREPARE_CACHE
+    char *prepare_cache;
+#endif
 } InitArgs;
 
 #define CLASS_CB(classRef)           ((ClassBlock*)(classRef+1))
@@ -796,6 +960,8 @@ typedef struct InitArgs {
 #define IS_ENUM(cb)                  (cb->access_flags & ACC_ENUM)
 #define IS_ARRAY(cb)                 (cb->state == CLASS_ARRAY)
 #define IS_PRIMITIVE(cb)             (cb->state >= CLASS_PRIM)
+#define IS_LINKED(cb)                (cb->state >= CLASS_LINKED && \
+                                      cb->state < CLASS_ARRAY)
  
 #define IS_FINALIZED(cb)             (cb->flags & FINALIZED)
 #define IS_REFERENCE(cb)             (cb->flags & REFERENCE)
@@ -875,9 +1041,21 @@ typedef struct InitArgs {
 /* default size of the Java stack */
 #define DEFAULT_STACK 256*KB
 
+/* default size the Java stack may grow to.  This is
+   reserved, but only committed as the stack grows */
+#ifndef DEFAULT_MAX_STACK
+#define DEFAULT_MAX_STACK 2*MB
+#endif
+
 /* size of emergency area - big enough to create
-   a StackOverflow exception */
+   a StackOverflow exception.  With implicit stack
+   checks it is protected when not in use, so it
+   must be a multiple of the page size */
+#ifdef IMPLICIT_STACK_CHECKS
+#define STACK_RED_ZONE_SIZE 4*KB
+#else
 #define STACK_RED_ZONE_SIZE 1*KB
+#endif
 
 #define JAVA_COMPAT_VERSION "1.5.0"
 
@@ -962,6 +1140,7 @@ extern Class *parseClass(char *classname, char *data, int offset, int len,
 extern Class *defineClass(char *classname, char *data, int offset, int len,
                           Object *class_loader);
 extern void linkClass(Class *class);
+extern int findIMethodTableIndex(ClassBlock *cb, Class *interface);
 extern Class *initClass(Class *class);
 extern Class *findSystemClass(char *name);
 extern Class *findSystemClass0(char *name);
@@ -1021,6 +1200,7 @@ extern Class *resolveClass(Class *class, int index, int check_access, int init);
 extern MethodBlock *resolveMethod(Class *class, int index);
 extern MethodBlock *resolveInterfaceMethod(Class *class, int index);
 extern FieldBlock *resolveField(Class *class, int index);
+extern int isTrivialMethod(MethodBlock *mb);
 extern uintptr_t resolveSingleConstant(Class *class, int index);
 extern int peekIsFieldLong(Class *class, int index);
 
@@ -1062,11 +1242,12 @@ extern int mapPC2LineNo(MethodBlock *mb, CodePntr pc_pntr);
 extern Object *stackTraceElements(Object *trace);
 extern Object *stackTrace(ExecEnv *ee, int max_depth);
 extern Object *stackTraceElement(MethodBlock *mb, CodePntr pc);
-extern int initialiseException();
+extern int initialiseException(InitArgs *args);
+extern void flushCatchCaches();
 
 extern int countStackFrames(Frame *last, int max_depth);
 extern Object *convertTrace2Elements(void **trace, int len);
-extern void stackTrace2Buffer(Frame *last, void **data, int max_depth);
+extern int stackTrace2Buffer(Frame *last, void **data, int max_depth);
 
 extern Object *convertStackTrace(Object *vmthrwble);
 extern Object *setStackTrace0(ExecEnv *ee, int max_depth);
@@ -1095,6 +1276,20 @@ extern Object *exceptionEnumToException(int excep_enum);
 extern uintptr_t *executeJava();
 extern void shutdownInterpreter();
 extern int initialiseInterpreter(InitArgs *args);
+#ifdef IMPLICIT_NULL_CHECKS
+extern void interpreterNullFault(void *native_pc);
+#endif
+#ifdef IMPLICIT_STACK_CHECKS
+extern int interpreterStackFault(void *native_pc, void *addr);
+#endif
+
+#ifdef DIRECT
+extern InterfaceCache *newInterfaceCache(MethodBlock *owner,
+                                         MethodBlock *imethod);
+extern MethodBlock *lookupInterfaceCache(InterfaceCache *cache, Class *class);
+extern void scanInterfaceCaches();
+extern void threadInterfaceCaches();
+#endif
 
 /* String */
 
@@ -1112,6 +1307,17 @@ extern char *StringRegion2Utf8(Object *string, int start, int len, char *utf8);
 extern void freeInternedStrings();
 extern void threadInternedStrings();
 extern int initialiseString();
+extern uintptr_t *stringEquals(Class *class, MethodBlock *mb,
+                               uintptr_t *ostack);
+extern uintptr_t *stringHashCode(Class *class, MethodBlock *mb,
+                                 uintptr_t *ostack);
+extern uintptr_t *stringIndexOf(Class *class, MethodBlock *mb,
+                                uintptr_t *ostack);
+
+/* Intrinsics */
+
+extern NativeMethod lookupIntrinsic(MethodBlock *mb);
+extern int initialiseIntrinsics(InitArgs *args);
 
 #define Cstr2String(cstr) createString(cstr)
 
@@ -1166,6 +1372,9 @@ extern void *nativeStackBase();
 extern char *nativeJVMPath();
 extern int nativeAvailableProcessors();
 extern long long nativePhysicalMemory();
+#ifdef IMPLICIT_CHECKS
+extern void nativeCatchFaults();
+#endif
 
 extern char *convertSig2Simple(char *sig);
 
@@ -1176,15 +1385,32 @@ extern int initialiseThreadStage2(InitArgs *args);
 extern ExecEnv *getExecEnv();
 
 extern void createJavaThread(Object *jThread, long long stack_size);
+extern int growJavaStack(ExecEnv *ee, char *sp);
+extern void useStackRedZone(ExecEnv *ee);
+extern void releaseStackRedZone(ExecEnv *ee);
+#ifdef IMPLICIT_STACK_CHECKS
+extern int isJavaStackAddress(ExecEnv *ee, void *addr);
+#endif
+extern void javaStackMemoryUsage(long long *committed, long long *reserved);
 extern void mainThreadSetContextClassLoader(Object *loader);
 extern void mainThreadWaitToExitVM();
 extern void uncaughtException();
 extern void exitVM(int status);
 extern void scanThreads();
+extern void scanThreadsCodeRefs();
 
 /* Monitors */
 
 extern int initialiseMonitor();
+extern int initialiseLockProfile(InitArgs *args);
+extern void shutdownLockProfile();
+
+/* CPU profiler */
+
+extern int initialiseCPUProfile(InitArgs *args);
+extern int initialiseCPUProfileThread();
+extern void shutdownCPUProfile();
+extern void drainCPUProfile();
 
 /* JNI */
 
@@ -1293,6 +1519,44 @@ extern void freeMethodInlinedInfo(MethodBlock *mb);
 extern int  initialiseInlining(InitArgs *args);
 extern void showRelocatability();
 extern void shutdownInlining();
+extern int  initialiseInliningThread();
+extern void codeMemoryUsage(long long *used, long long *committed,
+                            long long *max);
+extern long long peakCodeMem();
+extern long long sweptCodeMem();
+extern void markInliningQueue();
+extern void sweepCodeMemory();
+
+/* opcode statistics */
+
+#ifdef OPCODE_STATS
+typedef struct opcode_stats {
+    unsigned long long opcodes[256];
+    unsigned long long pairs[256][256];
+} OpcodeStats;
+
+extern OpcodeStats *opcodeStats();
+extern int initialiseOpcodeStats(InitArgs *args);
+extern void shutdownOpcodeStats();
+#ifdef INLINING
+extern void opcodeStatsAddBlock(MethodBlock *mb, Instruction *start,
+                                Instruction *end);
+extern void opcodeStatsFreeMethod(MethodBlock *mb);
+#endif
+#endif
+
+/* prepared-code cache */
+
+#ifdef PREPARE_CACHE
+extern u8 prepareCacheHash(char *data, int len);
+extern int prepareCacheLoad(MethodBlock *mb, const void ***handlers,
+                            Instruction **code, int *ins_count);
+extern void prepareCacheSave(MethodBlock *mb, Instruction *code,
+                             int ins_count, unsigned char *bytecode,
+                             short *map, const void ***handlers);
+extern int initialisePrepareCache(InitArgs *args);
+extern void shutdownPrepareCache();
+#endif
 
 /* symbol */
 
@@ -87,7 +87,8 @@ int initJNILrefs() {
 JNIFrame *expandJNILrefs(ExecEnv *ee, JNIFrame *frame, int incr) {
     JNIFrame *new_frame = (JNIFrame*)((Object**)frame + incr);
 
-    if((char*)(new_frame + 1) > ee->stack_end)
+    if((char*)(new_frame + 1) > ee->stack_end &&
+                 !growJavaStack(ee, (char*)(new_frame + 1)))
         return NULL;
 
     memcpy(new_frame, frame, sizeof(JNIFrame));
@@ -116,7 +117,7 @@ JNIFrame *ensureJNILrefCapacity(int cap) {
                 jam_fprintf(stderr, "Fatal stack overflow!  Aborting VM.\n");
                 exitVM(1);
             }
-            ee->stack_end += STACK_RED_ZONE_SIZE;
+            useStackRedZone(ee);
             signalException(java_lang_StackOverflowError,
                             "JNI local references");
         }
@@ -159,7 +160,8 @@ JNIFrame *pushJNILrefFrame(int cap) {
     JNIFrame *frame = (JNIFrame*)ee->last_frame;
     JNIFrame *new_frame = (JNIFrame*)((Object**)(frame + 1) + cap);
 
-    if((char*)(new_frame + 1) > ee->stack_end) {
+    if((char*)(new_frame + 1) > ee->stack_end &&
+                 !growJavaStack(ee, (char*)(new_frame + 1))) {
         signalException(java_lang_OutOfMemoryError, "JNI local references");
         return NULL;
     }
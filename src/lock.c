@@ -47,7 +47,16 @@
 
 #define HASHTABSZE 1<<5
 #define PREPARE(obj) allocMonitor(obj)
-#define HASH(obj) (getObjectHashcode(obj) >> LOG_OBJECT_GRAIN)
+
+/* The monitor cache is split into a number of independently locked
+   stripes to reduce contention.  Monitors are hashed on the object's
+   address rather than its hashcode (taking the hashcode would force
+   the object to grow on compaction).  Objects being locked are
+   referenced from a thread stack and so are pinned during compaction,
+   but other entries may move, so the cache is rehashed afterwards */
+#define MON_CACHE_STRIPES 16
+#define HASH(obj) ((uintptr_t)(obj) >> LOG_OBJECT_GRAIN)
+#define STRIPE(hash) (((hash) ^ ((hash) >> 4)) & (MON_CACHE_STRIPES-1))
 #define COMPARE(obj, mon, hash1, hash2) hash1 == hash2 && mon->obj == obj
 #define FOUND(ptr1, ptr2)                                    \
 ({                                                           \
@@ -87,18 +96,24 @@
     char res = LOCKWORD_READ(&mon->entering) == UN_USED;        \
     if(res) {                                                   \
         TRACE("Scavenging monitor %p (obj %p)", mon, mon->obj); \
+        pthread_mutex_lock(&mon_free_lock);                     \
         mon->next = mon_free_list;                              \
         mon_free_list = mon;                                    \
+        pthread_mutex_unlock(&mon_free_lock);                   \
     }                                                           \
     res;                                                        \
 })
 
+/* The free list is shared between the cache stripes */
+static pthread_mutex_t mon_free_lock = PTHREAD_MUTEX_INITIALIZER;
 static Monitor *mon_free_list = NULL;
-static HashTable mon_cache;
+static HashTable mon_cache[MON_CACHE_STRIPES];
 
 void monitorInit(Monitor *mon) {
     memset(mon, 0, sizeof(Monitor));
     pthread_mutex_init(&mon->lock, NULL);
+    pthread_mutex_init(&mon->flc_lock, NULL);
+    pthread_cond_init(&mon->flc_cv, NULL);
 }
 
 void waitSetAppend(Monitor *mon, Thread *thread) {
@@ -140,6 +155,8 @@ void monitorLock(Monitor *mon, Thread *self) {
         mon->count++;
     else {
         if(pthread_mutex_trylock(&mon->lock)) {
+            long long start = lock_profiling ? lockProfileTime() : 0;
+
             disableSuspend(self);
 
             self->blocked_mon = mon;
@@ -152,21 +169,13 @@ void monitorLock(Monitor *mon, Thread *self) {
             self->blocked_mon = NULL;
 
             enableSuspend(self);
-        }
-        mon->owner = self;
-    }
-}
 
-int monitorTryLock(Monitor *mon, Thread *self) {
-    if(mon->owner == self)
-        mon->count++;
-    else {
-        if(pthread_mutex_trylock(&mon->lock))
-            return FALSE;
+            if(lock_profiling && start)
+                lockProfileContended(mon->obj, self,
+                                     lockProfileTime() - start);
+        }
         mon->owner = self;
     }
-
-    return TRUE;
 }
 
 void monitorUnlock(Monitor *mon, Thread *self) {
@@ -190,10 +199,14 @@ int monitorWait(Monitor *mon, Thread *self, long long ms, int ns,
     if(!interrupted) {
         char timed = (ms != 0) || (ns != 0);
         char timeout = FALSE;
+        long long start = 0;
         struct timespec ts;
         int old_count;
         int state;
 
+        if(lock_profiling)
+            start = lockProfileTime();
+
         disableSuspend(self);
 
         /* Unlock the monitor.  As it could be recursively
@@ -275,6 +288,19 @@ int monitorWait(Monitor *mon, Thread *self, long long ms, int ns,
         mon->in_wait--;
 
         enableSuspend(self);
+
+        if(lock_profiling && start) {
+            long long time = lockProfileTime() - start;
+
+            if(state == BLOCKED)
+                lockProfileContended(mon->obj, self, time);
+            else {
+                self->waited_time += time;
+
+                if(is_wait)
+                    lockProfileWait(mon->obj, self, time);
+            }
+        }
     }
 
     if(interrupted) {
@@ -306,13 +332,74 @@ int monitorNotifyAll(Monitor *mon, Thread *self) {
     return TRUE;
 }
 
+/* Flat lock contention.  A thread contending a thin lock owns the
+   monitor and sets the FLC bit.  It then waits for the thin lock to be
+   released, without holding the monitor (the thin owner may need it to
+   inflate on wait).  The thin owner signals a release via flc_seq and
+   flc_cv.  These are protected by flc_lock, which is only ever held
+   briefly, so the unlocking thread never needs the monitor itself and
+   never spins waiting for it. */
+
+static void monitorFlcWait(Monitor *mon, Thread *self, unsigned int seq) {
+    long long start = lock_profiling ? lockProfileTime() : 0;
+    int old_count = mon->count;
+
+    disableSuspend(self);
+
+    self->blocked_mon = mon;
+    self->blocked_count++;
+    classlibSetThreadState(self, BLOCKED);
+
+    /* Prevents deflation until we've re-acquired the monitor */
+    mon->in_wait++;
+
+    mon->owner = NULL;
+    mon->count = 0;
+    pthread_mutex_unlock(&mon->lock);
+
+    pthread_mutex_lock(&mon->flc_lock);
+    while(mon->flc_seq == seq)
+        pthread_cond_wait(&mon->flc_cv, &mon->flc_lock);
+    pthread_mutex_unlock(&mon->flc_lock);
+
+    pthread_mutex_lock(&mon->lock);
+    mon->owner = self;
+    mon->count = old_count;
+    mon->in_wait--;
+
+    classlibSetThreadState(self, RUNNING);
+    self->blocked_mon = NULL;
+
+    enableSuspend(self);
+
+    if(lock_profiling && start)
+        lockProfileContended(mon->obj, self, lockProfileTime() - start);
+}
+
+static void monitorFlcNotify(Monitor *mon, Thread *self, int all) {
+    fastDisableSuspend(self);
+    pthread_mutex_lock(&mon->flc_lock);
+
+    mon->flc_seq++;
+
+    if(all)
+        pthread_cond_broadcast(&mon->flc_cv);
+    else
+        pthread_cond_signal(&mon->flc_cv);
+
+    pthread_mutex_unlock(&mon->flc_lock);
+    fastEnableSuspend(self);
+}
+
 Monitor *allocMonitor(Object *obj) {
     Monitor *mon;
 
-    if(mon_free_list != NULL) {
-        mon = mon_free_list;
-        mon_free_list = mon->next;      
-    } else {
+    pthread_mutex_lock(&mon_free_lock);
+    if((mon = mon_free_list) != NULL)
+        mon_free_list = mon->next;
+    pthread_mutex_unlock(&mon_free_lock);
+
+    if(mon == NULL) {
         mon = sysMalloc(sizeof(Monitor));
         monitorInit(mon);
     }
@@ -329,17 +416,23 @@ Monitor *findMonitor(Object *obj) {
     if(lockword & SHAPE_BIT)
         return (Monitor*) (lockword & ~SHAPE_BIT);
     else {
+        HashTable *table = &mon_cache[STRIPE(HASH(obj))];
         Monitor *mon;
+
         /* Add if absent, scavenge, locked */
-        findHashEntry(mon_cache, obj, mon, TRUE, TRUE, TRUE);
+        findHashEntry((*table), obj, mon, TRUE, TRUE, TRUE);
         return mon;
     }
 }
 
 static void inflate(Object *obj, Monitor *mon, Thread *self) {
     TRACE("Thread %p is inflating obj %p...\n", self, obj);
+
+    if(lock_profiling)
+        lockProfileInflate(obj, self);
+
     clearFlcBit(obj);
-    monitorNotifyAll(mon, self);
+    monitorFlcNotify(mon, self, TRUE);
     LOCKWORD_WRITE(&obj->lock, (uintptr_t) mon | SHAPE_BIT);
 }
 
@@ -397,12 +490,17 @@ try_again2:
                                                 entering, entering-1)));
 
     while((LOCKWORD_READ(&obj->lock) & SHAPE_BIT) == 0) {
+        /* Read the release sequence before trying the lockword.  A
+           release after a failed attempt will change it (the barrier
+           in setFlcBit orders the read) */
+        unsigned int flc_seq = mon->flc_seq;
+
         setFlcBit(obj);
 
         if(LOCKWORD_COMPARE_AND_SWAP(&obj->lock, 0, thin_locked))
             inflate(obj, mon, self);
         else
-            monitorWait(mon, self, 0, 0, FALSE, FALSE);
+            monitorFlcWait(mon, self, flc_seq);
     }
 }
 
@@ -422,19 +520,12 @@ void objectUnlock(Object *obj) {
         /* Required by thin-locking mechanism. */
         MBARRIER();
 
-retry:
+        /* Hand off to the first thread waiting for the release.
+           If the lock has been inflated in the meantime the
+           notify is spurious, but harmless */
         if(testFlcBit(obj)) {
             Monitor *mon = findMonitor(obj);
-
-            if(!monitorTryLock(mon, self)) {
-                threadYield(self);
-                goto retry;
-            }
-
-            if(testFlcBit(obj) && (mon->obj == obj))
-                monitorNotify(mon, self);
-
-            monitorUnlock(mon, self);
+            monitorFlcNotify(mon, self, FALSE);
         }
     } else {
         if((lockword & (TID_MASK|SHAPE_BIT)) == thin_locked)
@@ -559,8 +650,11 @@ Thread *objectLockedBy(Object *obj) {
 }
 
 int initialiseMonitor() {
-    /* Init hash table, create lock */
-    initHashTable(mon_cache, HASHTABSZE, TRUE);
+    int i;
+
+    /* Init hash table stripes, create locks */
+    for(i = 0; i < MON_CACHE_STRIPES; i++)
+        initHashTable(mon_cache[i], HASHTABSZE, TRUE);
 
     return TRUE;
 }
@@ -574,5 +668,55 @@ int initialiseMonitor() {
 }
 
 void threadMonitorCache() {
-   hashIterate(mon_cache);
+    int i;
+
+    for(i = 0; i < MON_CACHE_STRIPES; i++)
+        hashIterate(mon_cache[i]);
+}
+
+static void addMonitorCacheEntry(Monitor *mon) {
+    int hash = HASH(mon->obj);
+    HashTable *table = &mon_cache[STRIPE(hash)];
+    int i = hash & (table->hash_size - 1);
+
+    while(table->hash_table[i].data != NULL)
+        i = (i+1) & (table->hash_size - 1);
+
+    table->hash_table[i].hash = hash;
+    table->hash_table[i].data = mon;
+
+    if((++table->hash_count * 4) > (table->hash_size * 3))
+        resizeHash(table, table->hash_size*2);
+}
+
+/* Called after compaction, with the world stopped.  Entries are
+   re-inserted using the objects' new addresses.  Unused monitors
+   are scavenged onto the free list */
+
+void rehashMonitorCache() {
+    HashEntry *old_tables[MON_CACHE_STRIPES];
+    int old_sizes[MON_CACHE_STRIPES];
+    int i, j;
+
+    for(i = 0; i < MON_CACHE_STRIPES; i++) {
+        int size = mon_cache[i].hash_size;
+
+        old_tables[i] = mon_cache[i].hash_table;
+        old_sizes[i] = size;
+
+        mon_cache[i].hash_table = gcMemMalloc(sizeof(HashEntry)*size);
+        memset(mon_cache[i].hash_table, 0, sizeof(HashEntry)*size);
+        mon_cache[i].hash_count = 0;
+    }
+
+    for(i = 0; i < MON_CACHE_STRIPES; i++) {
+        for(j = 0; j < old_sizes[i]; j++) {
+            void *data = old_tables[i][j].data;
+
+            if(data != NULL && !SCAVENGE(data))
+                addMonitorCacheEntry(data);
+        }
+
+        gcMemFree(old_tables[i]);
+    }
 }
@@ -37,3 +37,15 @@ extern void objectWait(Object *ob, long long ms, int ns, int interruptible);
 extern int objectLockedByCurrent(Object *ob);
 extern Thread *objectLockedBy(Object *ob);
 extern void threadMonitorCache();
+extern void rehashMonitorCache();
+
+/* Monitor contention profiling */
+
+extern int lock_profiling;
+
+extern long long lockProfileTime();
+extern void lockProfileContended(Object *obj, Thread *self, long long time);
+extern void lockProfileWait(Object *obj, Thread *self, long long time);
+extern void lockProfileInflate(Object *obj, Thread *self);
+extern void setLockProfiling(int enable);
+extern void printLockProfile();
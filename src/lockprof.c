@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Monitor contention profiling.  Contended monitor enters (each time
+   a thread blocks entering a monitor), monitor waits and thin-to-fat
+   inflations are recorded against the class of the locked object and
+   the call site (method and line).  All recording is on paths where
+   the thread is about to block or has just blocked, and recording in
+   the site table may be sampled (every nth event per-thread).  The
+   per-thread blocked and waited times are always accumulated while
+   profiling is enabled (these are used by the management interfaces). */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jam.h"
+#include "lock.h"
+#include "thread.h"
+
+#define PROF_TABLE_SIZE 1024
+
+#define DEFAULT_REPORT_SIZE 20
+
+typedef struct lock_prof_entry {
+    char *obj_class;
+    char is_class;
+    char *site_class;
+    char *site_method;
+    char *site_type;
+    int site_line;
+    long long contended;
+    long long blocked_ns;
+    long long waits;
+    long long waited_ns;
+    long long inflations;
+    struct lock_prof_entry *next;
+} LockProfEntry;
+
+int lock_profiling = FALSE;
+
+static int report_size = DEFAULT_REPORT_SIZE;
+static int sample_interval = 1;
+static int profile_at_exit = FALSE;
+
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+static LockProfEntry *prof_table[PROF_TABLE_SIZE];
+static int prof_entries = 0;
+
+long long lockProfileTime() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Site line numbers use the following values if the
+   line is not available */
+#define LINE_UNKNOWN  -1
+#define LINE_NATIVE   -2
+#define LINE_VM       -3
+
+static LockProfEntry *findEntry(Object *obj, Thread *self) {
+    Frame *frame = self->ee != NULL ? self->ee->last_frame : NULL;
+    MethodBlock *mb = frame != NULL ? frame->mb : NULL;
+    char *obj_class, *site_class, *site_method, *site_type;
+    LockProfEntry *entry;
+    int site_line, hash;
+    char is_class;
+
+    if((is_class = IS_CLASS(obj)))
+        obj_class = CLASS_CB((Class*)obj)->name;
+    else
+        obj_class = CLASS_CB(obj->class)->name;
+
+    if(mb == NULL) {
+        site_class = site_method = site_type = NULL;
+        site_line = LINE_VM;
+    } else {
+        site_class = CLASS_CB(mb->class)->name;
+        site_method = mb->name;
+        site_type = mb->type;
+
+        if(mb->access_flags & ACC_NATIVE)
+            site_line = LINE_NATIVE;
+        else {
+            CodePntr pc = frame->last_pc;
+
+            /* On entry to a synchronized method, the frame's pc
+               has not been set.  A monitorenter on the same object
+               within the method can't be contended */
+            if(mb->access_flags & ACC_SYNCHRONIZED &&
+                    (mb->access_flags & ACC_STATIC ? (Object*)mb->class
+                                       : (Object*)frame->lvars[0]) == obj)
+                pc = (CodePntr)mb->code;
+
+            site_line = mapPC2LineNo(mb, pc);
+        }
+    }
+
+    hash = ((uintptr_t)obj_class ^ ((uintptr_t)site_method >> 3) ^
+            ((uintptr_t)site_class >> 5) ^ site_line) & (PROF_TABLE_SIZE-1);
+
+    for(entry = prof_table[hash]; entry != NULL; entry = entry->next)
+        if(entry->obj_class == obj_class && entry->is_class == is_class &&
+                entry->site_class == site_class &&
+                entry->site_method == site_method &&
+                entry->site_type == site_type &&
+                entry->site_line == site_line)
+            return entry;
+
+    entry = sysMalloc(sizeof(LockProfEntry));
+    memset(entry, 0, sizeof(LockProfEntry));
+
+    entry->obj_class = obj_class;
+    entry->is_class = is_class;
+    entry->site_class = site_class;
+    entry->site_method = site_method;
+    entry->site_type = site_type;
+    entry->site_line = site_line;
+
+    entry->next = prof_table[hash];
+    prof_table[hash] = entry;
+    prof_entries++;
+
+    return entry;
+}
+
+#define PROF_CONTENDED 0
+#define PROF_WAIT      1
+#define PROF_INFLATE   2
+
+static void recordEvent(Object *obj, Thread *self, int type,
+                        long long time) {
+    LockProfEntry *entry;
+
+    if(obj == NULL || obj->class == NULL)
+        return;
+
+    if(sample_interval > 1 && self->lock_prof_tick++ % sample_interval)
+        return;
+
+    fastDisableSuspend(self);
+    pthread_mutex_lock(&prof_lock);
+
+    entry = findEntry(obj, self);
+
+    switch(type) {
+        case PROF_CONTENDED:
+            entry->contended++;
+            entry->blocked_ns += time;
+            break;
+
+        case PROF_WAIT:
+            entry->waits++;
+            entry->waited_ns += time;
+            break;
+
+        default:
+            entry->inflations++;
+            break;
+    }
+
+    pthread_mutex_unlock(&prof_lock);
+    fastEnableSuspend(self);
+}
+
+void lockProfileContended(Object *obj, Thread *self, long long time) {
+    self->blocked_time += time;
+    recordEvent(obj, self, PROF_CONTENDED, time);
+}
+
+void lockProfileWait(Object *obj, Thread *self, long long time) {
+    recordEvent(obj, self, PROF_WAIT, time);
+}
+
+void lockProfileInflate(Object *obj, Thread *self) {
+    recordEvent(obj, self, PROF_INFLATE, 0);
+}
+
+void setLockProfiling(int enable) {
+    lock_profiling = enable;
+}
+
+static int compareEntries(const void *pntr1, const void *pntr2) {
+    LockProfEntry *entry1 = *(LockProfEntry**)pntr1;
+    LockProfEntry *entry2 = *(LockProfEntry**)pntr2;
+    long long time1 = entry1->blocked_ns + entry1->waited_ns;
+    long long time2 = entry2->blocked_ns + entry2->waited_ns;
+
+    if(time1 != time2)
+        return time1 < time2 ? 1 : -1;
+
+    if(entry1->contended != entry2->contended)
+        return entry1->contended < entry2->contended ? 1 : -1;
+
+    return entry1->inflations < entry2->inflations ? 1 :
+           entry1->inflations > entry2->inflations ? -1 : 0;
+}
+
+void printLockProfile() {
+    LockProfEntry **entries;
+    Thread *self = threadSelf();
+    char buff[256];
+    int i, count;
+
+    fastDisableSuspend(self);
+    pthread_mutex_lock(&prof_lock);
+
+    if(prof_entries == 0)
+        goto out;
+
+    entries = sysMalloc(prof_entries * sizeof(LockProfEntry*));
+
+    for(count = i = 0; i < PROF_TABLE_SIZE; i++) {
+        LockProfEntry *entry;
+
+        for(entry = prof_table[i]; entry != NULL; entry = entry->next)
+            entries[count++] = entry;
+    }
+
+    qsort(entries, count, sizeof(LockProfEntry*), compareEntries);
+
+    jam_printf("\n------ JamVM Monitor Contention Profile -------\n");
+
+    if(sample_interval > 1)
+        jam_printf("(sampled every %d events)\n", sample_interval);
+
+    jam_printf("%10s %12s %10s %12s %8s  object class / call site\n",
+               "contended", "blocked(ms)", "waits", "waited(ms)", "inflate");
+
+    for(i = 0; i < count && i < report_size; i++) {
+        LockProfEntry *entry = entries[i];
+
+        jam_printf("%10lld %12.3f %10lld %12.3f %8lld  %s%s\n",
+                   entry->contended, entry->blocked_ns / 1000000.0,
+                   entry->waits, entry->waited_ns / 1000000.0,
+                   entry->inflations, entry->is_class ? "class " : "",
+                   slash2DotsBuff(entry->obj_class, buff, sizeof(buff)));
+
+        if(entry->site_class == NULL)
+            jam_printf("%58s  at <VM internal>\n", "");
+        else {
+            jam_printf("%58s  at %s.%s%s", "",
+                       slash2DotsBuff(entry->site_class, buff, sizeof(buff)),
+                       entry->site_method, entry->site_type);
+
+            if(entry->site_line == LINE_NATIVE)
+                jam_printf(" (Native method)\n");
+            else if(entry->site_line == LINE_UNKNOWN)
+                jam_printf(" (Unknown line)\n");
+            else
+                jam_printf(" (line %d)\n", entry->site_line);
+        }
+    }
+
+    sysFree(entries);
+
+out:
+    pthread_mutex_unlock(&prof_lock);
+    fastEnableSuspend(self);
+}
+
+void shutdownLockProfile() {
+    if(profile_at_exit)
+        printLockProfile();
+}
+
+int initialiseLockProfile(InitArgs *args) {
+    if(args->lock_profile_report) {
+        report_size = args->lock_profile_report;
+        sample_interval = args->lock_profile_sample;
+        profile_at_exit = lock_profiling = TRUE;
+    }
+
+    return TRUE;
+}
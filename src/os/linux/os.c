@@ -28,6 +28,8 @@
 #define __USE_GNU
 #include <dlfcn.h>
 #include <pthread.h>
+#include <signal.h>
+#include <ucontext.h>
 
 #include "../../jam.h"
 
@@ -106,3 +108,46 @@ char *nativeJVMPath() {
     return path;
 }
 
+#ifdef IMPLICIT_CHECKS
+/* Implicit null and stack checks.  A fault on a low address or on
+   the thread's Java stack is passed to the interpreter, which doesn't
+   return if the fault was a null dereference or a stack overflow in
+   one of its handlers.  A stack fault which grew the stack is retried.
+   Otherwise the default action is restored, and the fault is repeated
+   when the handler returns */
+
+static void *contextPC(ucontext_t *uc) {
+#if defined(__x86_64__)
+    return (void*)uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+    return (void*)uc->uc_mcontext.gregs[REG_EIP];
+#else
+    return (void*)uc->uc_mcontext.arm_pc;
+#endif
+}
+
+static void faultHandler(int sig, siginfo_t *info, void *context) {
+#ifdef IMPLICIT_NULL_CHECKS
+    if((uintptr_t)info->si_addr < IMPLICIT_NULL_LIMIT)
+        interpreterNullFault(contextPC(context));
+#endif
+#ifdef IMPLICIT_STACK_CHECKS
+    if(interpreterStackFault(contextPC(context), info->si_addr))
+        return;
+#endif
+
+    signal(SIGSEGV, SIG_DFL);
+}
+
+/* The handler is entered with SIGSEGV unblocked, as the interpreter
+   long-jumps out of it without restoring the signal mask */
+
+void nativeCatchFaults() {
+    struct sigaction act;
+
+    act.sa_sigaction = faultHandler;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigaction(SIGSEGV, &act, NULL);
+}
+#endif
@@ -365,6 +365,51 @@ retry:
     return fb;
 }
 
+/* Returns TRUE if calls to the method can be performed inline (see
+   findTrivialMethod in class.c).  The field or constructor used by
+   the method is resolved on the first call.  If this fails the method
+   is invoked normally, and the error is thrown when it executes */
+
+int isTrivialMethod(MethodBlock *mb) {
+    int trivial = mb->trivial;
+
+    if(trivial == TRIVIAL_GETTER || trivial == TRIVIAL_SETTER) {
+        FieldBlock *fb = resolveField(mb->class, mb->trivial_index);
+
+        if(fb == NULL || fb->access_flags & ACC_STATIC) {
+            clearException();
+            trivial = 0;
+        } else {
+            trivial = trivial == TRIVIAL_GETTER ? TRIVIAL_GETFIELD
+                                                : TRIVIAL_PUTFIELD;
+
+            if(*fb->type == 'J' || *fb->type == 'D')
+                trivial += 2;
+            else if(*fb->type == 'L' || *fb->type == '[')
+                trivial += 1;
+
+            mb->trivial_operand = fb->u.offset;
+        }
+    } else if(trivial == TRIVIAL_INIT) {
+        MethodBlock *init = resolveMethod(mb->class, mb->trivial_index);
+
+        /* A constructor calling an empty constructor is also empty */
+        if(init == NULL || init == mb || init->name != SYMBOL(object_init)
+                        || !isTrivialMethod(init)
+                        || init->trivial != TRIVIAL_EMPTY) {
+            clearException();
+            trivial = 0;
+        } else
+            trivial = TRIVIAL_EMPTY;
+    } else
+        return trivial != 0;
+
+    MBARRIER();
+    mb->trivial = trivial;
+
+    return trivial != 0;
+}
+
 uintptr_t resolveSingleConstant(Class *class, int cp_index) {
     ConstantPool *cp = &(CLASS_CB(class)->constant_pool);
 
@@ -423,12 +468,9 @@ MethodBlock *lookupVirtualMethod(Object *ob, MethodBlock *mb) {
         return mb;
 
     if(CLASS_CB(mb->class)->access_flags & ACC_INTERFACE) {
-        int i;
-
-        for(i = 0; (i < cb->imethod_table_size) &&
-                   (mb->class != cb->imethod_table[i].interface); i++);
+        int i = findIMethodTableIndex(cb, mb->class);
 
-        if(i == cb->imethod_table_size) {
+        if(i == -1) {
             signalException(java_lang_IncompatibleClassChangeError,
                             "unimplemented interface");
             return NULL;
@@ -21,7 +21,15 @@
 #include "jam.h"
 
 void shutdownVM() {
+    shutdownLockProfile();
+    shutdownCPUProfile();
     shutdownInterpreter();
+#ifdef OPCODE_STATS
+    shutdownOpcodeStats();
+#endif
+#ifdef PREPARE_CACHE
+    shutdownPrepareCache();
+#endif
     shutdownDll();
 }
 
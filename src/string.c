@@ -39,6 +39,10 @@ static HashTable hash_table;
 static Class *string_class;
 static int value_offset;
 
+/* Offset of the cached hash code, or -1 if the class
+   library's String does not cache it */
+static int hash_offset = -1;
+
 #ifdef SHARED_CHAR_BUFFERS
 static int count_offset; 
 static int offset_offset;
@@ -177,8 +181,76 @@ char *String2Cstr(Object *string) {
     return String2Buff0(string, buff, len);
 }
 
+/* Intrinsic implementations of String methods (see intrinsics.c) */
+
+uintptr_t *stringEquals(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *string = (Object*)ostack[0];
+    Object *other = (Object*)ostack[1];
+    int equal = string == other;
+
+    if(!equal && other != NULL && other->class == string_class) {
+        int len = STRING_LEN(string);
+
+        if(len == STRING_LEN(other)) {
+            Object *array = INST_DATA(string, Object*, value_offset);
+            Object *array2 = INST_DATA(other, Object*, value_offset);
+            unsigned short *src = ARRAY_DATA(array, unsigned short) +
+                                  STRING_OFFSET(string);
+            unsigned short *src2 = ARRAY_DATA(array2, unsigned short) +
+                                   STRING_OFFSET(other);
+
+            equal = memcmp(src, src2, len * sizeof(unsigned short)) == 0;
+        }
+    }
+
+    *ostack++ = equal;
+    return ostack;
+}
+
+uintptr_t *stringHashCode(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *string = (Object*)ostack[0];
+    unsigned int hash;
+
+    if(hash_offset == -1)
+        return NULL;
+
+    /* A hash code of zero is recalculated each time, as in Java */
+    if((hash = INST_DATA(string, int, hash_offset)) == 0) {
+        int len = STRING_LEN(string);
+        Object *array = INST_DATA(string, Object*, value_offset);
+        unsigned short *dpntr = ARRAY_DATA(array, unsigned short) +
+                                STRING_OFFSET(string);
+
+        for(; len > 0; len--)
+            hash = hash * 31 + *dpntr++;
+
+        INST_DATA(string, int, hash_offset) = hash;
+    }
+
+    *ostack++ = (int)hash;
+    return ostack;
+}
+
+uintptr_t *stringIndexOf(Class *class, MethodBlock *mb, uintptr_t *ostack) {
+    Object *string = (Object*)ostack[0];
+    int ch = ostack[1];
+    int i, len = STRING_LEN(string);
+    Object *array = INST_DATA(string, Object*, value_offset);
+    unsigned short *dpntr = ARRAY_DATA(array, unsigned short) +
+                            STRING_OFFSET(string);
+
+    /* Supplementary characters need a surrogate pair search */
+    if(ch < 0 || ch >= 0x10000)
+        return NULL;
+
+    for(i = 0; i < len && dpntr[i] != ch; i++);
+
+    *ostack++ = i == len ? -1 : i;
+    return ostack;
+}
+
 int initialiseString() {
-    FieldBlock *value;
+    FieldBlock *value, *hash;
 
     string_class = findSystemClass0(SYMBOL(java_lang_String));
     if(string_class == NULL)
@@ -191,6 +263,13 @@ int initialiseString() {
     registerStaticClassRef(&string_class);
     value_offset = value->u.offset;
 
+    /* The name of the hash code field depends on the class library.
+       The hash intrinsic is only used if it is found */
+    if((hash = findField(string_class, findUtf8("hash"), SYMBOL(I))) != NULL
+            || (hash = findField(string_class, findUtf8("cachedHashCode"),
+                                 SYMBOL(I))) != NULL)
+        hash_offset = hash->u.offset;
+
 #ifdef SHARED_CHAR_BUFFERS
     {
         FieldBlock *count = findField(string_class, SYMBOL(count), SYMBOL(I));
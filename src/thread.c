@@ -25,6 +25,8 @@
 #include <signal.h>
 #include <sched.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "jam.h"
 #include "thread.h"
@@ -47,6 +49,37 @@ HashTable thread_id_map;
 /* Size of Java stack to use if no size is given */
 static int dflt_stack_size;
 
+/* Maximum size a thread's Java stack may grow to (unless the
+   initial size is larger) */
+static int dflt_max_stack_size;
+
+/* Total committed and reserved Java stack memory across all
+   threads, protected by stack_stats_lock */
+static pthread_mutex_t stack_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static long long stack_committed = 0;
+static long long stack_reserved = 0;
+
+/* Java stacks are reserved and committed in whole pages, with an
+   inaccessible guard area beyond the maximum size.  This is a single
+   page, except with implicit stack checks, where the end of any new
+   frame must fall within it (a frame has at most 64K local variables
+   and 64K operand stack slots) */
+static int page_size;
+static int guard_size;
+
+#define PAGE_ROUND(size) (((size) + page_size - 1) & ~(page_size - 1))
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+/* Cache of Java stacks from exited threads (see allocExecEnv) */
+#define STACK_CACHE_SIZE 32
+
+static pthread_mutex_t stack_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *stack_cache[STACK_CACHE_SIZE];
+static int stack_cache_count = 0;
+
 /* Thread create/destroy lock and condvar */
 static pthread_mutex_t lock;
 static pthread_cond_t cv;
@@ -110,25 +143,33 @@ static int threads_waiting_to_start = 0;
 
 static int main_exited = FALSE;
 
-/* Bitmap - used for generating unique thread ID's */
+/* Bitmap - used for generating unique thread ID's.  The hint is
+   the lowest word in the bitmap which may have a free ID */
 #define MAP_INC 32
 static unsigned int *tidBitmap = NULL;
 static int tidBitmapSize = 0;
+static int tidBitmapHint = 0;
 
 /* Mark a threadID value as no longer used */
-#define freeThreadID(n) tidBitmap[(n-1)>>5] &= ~(1<<((n-1)&0x1f))
+#define freeThreadID(n) {                        \
+    int idx = (n-1)>>5;                          \
+    tidBitmap[idx] &= ~(1<<((n-1)&0x1f));        \
+    if(idx < tidBitmapHint)                      \
+        tidBitmapHint = idx;                     \
+}
 
 /* Generate a new thread ID - assumes the thread queue
  * lock is held */
 
 static int genThreadID() {
-    int i = 0;
+    int i = tidBitmapHint;
 
 retry:
     for(; i < tidBitmapSize; i++) {
         if(tidBitmap[i] != 0xffffffff) {
             int n = ffs(~tidBitmap[i]);
             tidBitmap[i] |= 1 << (n-1);
+            tidBitmapHint = i;
             return (i<<5) + n;
         }
     }
@@ -427,13 +468,75 @@ void resetPeakThreadsCount() {
     enableSuspend(self);
 }
 
-void initialiseJavaStack(ExecEnv *ee) {
+static void updateStackStats(long long committed, long long reserved) {
+    pthread_mutex_lock(&stack_stats_lock);
+    stack_committed += committed;
+    stack_reserved += reserved;
+    pthread_mutex_unlock(&stack_stats_lock);
+}
+
+void javaStackMemoryUsage(long long *committed, long long *reserved) {
+    pthread_mutex_lock(&stack_stats_lock);
+    *committed = stack_committed;
+    *reserved = stack_reserved;
+    pthread_mutex_unlock(&stack_stats_lock);
+}
+
+/* The Java stack is reserved up to its maximum size plus a guard
+   area, but only the initial size is committed (made accessible).
+   The red zone is always within the committed area, so the guard
+   page is never touched by the interpreter -- it catches native
+   code running off the end of the stack.  When a frame would
+   overflow the committed area the stack is grown (see growJavaStack).
+
+   With implicit stack checks the red zone is also inaccessible
+   until a StackOverflowError is thrown (see useStackRedZone), so
+   the interpreter faults on a frame beyond the stack end */
+
+#ifdef IMPLICIT_STACK_CHECKS
+#define STACK_ACCESSIBLE(size) ((size) - STACK_RED_ZONE_SIZE)
+#else
+#define STACK_ACCESSIBLE(size) (size)
+#endif
+
+static void mapJavaStack(ExecEnv *ee) {
    int stack_size = ee->stack_size
           ? (ee->stack_size > MIN_STACK ? ee->stack_size : MIN_STACK)
           : dflt_stack_size;
-   char *stack = sysMalloc(stack_size);
-   MethodBlock *mb = (MethodBlock *)stack;
-   Frame *top = (Frame *)(mb + 1);
+   int max_size = stack_size > dflt_max_stack_size ? stack_size
+                                                   : dflt_max_stack_size;
+   char *stack;
+
+   stack_size = PAGE_ROUND(stack_size);
+   max_size = PAGE_ROUND(max_size);
+
+   stack = mmap(0, max_size + guard_size, PROT_NONE,
+                MAP_PRIVATE|MAP_ANON|MAP_NORESERVE, -1, 0);
+
+   if(stack == MAP_FAILED ||
+            mprotect(stack, STACK_ACCESSIBLE(stack_size),
+                     PROT_READ|PROT_WRITE) != 0) {
+       jam_fprintf(stderr, "Couldn't allocate Java stack - aborting VM...\n");
+       exitVM(1);
+   }
+
+   updateStackStats(stack_size, max_size + guard_size);
+
+   ee->stack = stack;
+   ee->stack_size = stack_size;
+   ee->stack_max = max_size;
+}
+
+void initialiseJavaStack(ExecEnv *ee) {
+   MethodBlock *mb;
+   Frame *top;
+
+   /* A stack may have been taken from the cache (see allocExecEnv) */
+   if(ee->stack == NULL)
+       mapJavaStack(ee);
+
+   mb = (MethodBlock *)ee->stack;
+   top = (Frame *)(mb + 1);
 
    top->ostack = (uintptr_t*)(top + 1);
    top->lvars = (uintptr_t*)top;
@@ -442,10 +545,149 @@ void initialiseJavaStack(ExecEnv *ee) {
    top->prev = NULL;
    top->mb = mb;
 
-   ee->stack = stack;
    ee->last_frame = top;
-   ee->stack_size = stack_size;
-   ee->stack_end = stack + stack_size-STACK_RED_ZONE_SIZE;
+   ee->stack_end = ee->stack + ee->stack_size-STACK_RED_ZONE_SIZE;
+
+#ifdef IMPLICIT_STACK_CHECKS
+   /* A cached stack's red zone may have been left accessible */
+   mprotect(ee->stack_end, STACK_RED_ZONE_SIZE, PROT_NONE);
+#endif
+}
+
+/* Called when sp is beyond the stack end.  Commit enough of the
+   reserved area so that sp is below the new stack end, doubling
+   the committed size each time.  Returns FALSE if the stack can't
+   be grown (the maximum has been reached or the thread is already
+   using the red zone to throw a StackOverflowError) */
+
+int growJavaStack(ExecEnv *ee, char *sp) {
+    int needed = sp - ee->stack + STACK_RED_ZONE_SIZE;
+    int size = ee->stack_size;
+    Thread *self;
+
+    if(ee->overflow || needed > ee->stack_max)
+        return FALSE;
+
+    while(size < needed)
+        size <<= 1;
+
+    if(size > ee->stack_max)
+        size = ee->stack_max;
+
+    if(mprotect(ee->stack + STACK_ACCESSIBLE(ee->stack_size),
+                size - ee->stack_size, PROT_READ|PROT_WRITE) != 0)
+        return FALSE;
+
+    self = threadSelf();
+    fastDisableSuspend(self);
+    updateStackStats(size - ee->stack_size, 0);
+    fastEnableSuspend(self);
+
+    TRACE("Thread %p grew Java stack from %d to %d\n", self,
+          ee->stack_size, size);
+
+    ee->stack_size = size;
+    ee->stack_end = ee->stack + size - STACK_RED_ZONE_SIZE;
+
+    return TRUE;
+}
+
+/* Called when a StackOverflowError is thrown, to let the thread use
+   the red zone to create and throw it, and when it is caught */
+
+void useStackRedZone(ExecEnv *ee) {
+#ifdef IMPLICIT_STACK_CHECKS
+    mprotect(ee->stack_end, STACK_RED_ZONE_SIZE, PROT_READ|PROT_WRITE);
+#endif
+    ee->stack_end += STACK_RED_ZONE_SIZE;
+}
+
+void releaseStackRedZone(ExecEnv *ee) {
+    ee->stack_end -= STACK_RED_ZONE_SIZE;
+
+#ifdef IMPLICIT_STACK_CHECKS
+    /* The exception is normally caught below the red zone, but
+       if a frame is still using it, leave it accessible */
+    {
+        Frame *last = ee->last_frame;
+
+        if((char*)(last->ostack + last->mb->max_stack) <= ee->stack_end)
+            mprotect(ee->stack_end, STACK_RED_ZONE_SIZE, PROT_NONE);
+    }
+#endif
+}
+
+#ifdef IMPLICIT_STACK_CHECKS
+int isJavaStackAddress(ExecEnv *ee, void *addr) {
+    return (char*)addr >= ee->stack &&
+           (char*)addr < ee->stack + ee->stack_max + guard_size;
+}
+#endif
+
+static void freeJavaStack(ExecEnv *ee) {
+    updateStackStats(-ee->stack_size, -(ee->stack_max + guard_size));
+    munmap(ee->stack, ee->stack_max + guard_size);
+}
+
+/* Starting and attaching threads take a Java stack from the cache
+   if one is available, and exiting threads return theirs.  Only
+   stacks of the default size, which have not grown, are cached.
+   The ExecEnv itself is not reused, as it is referenced from the
+   thread structure until this is freed (see gcPendingFreeThread) */
+
+static int dfltMaxStackSize() {
+    return PAGE_ROUND(dflt_stack_size > dflt_max_stack_size
+                                      ? dflt_stack_size : dflt_max_stack_size);
+}
+
+static ExecEnv *allocExecEnv(long long stack_size) {
+    ExecEnv *ee = sysMalloc(sizeof(ExecEnv));
+
+    memset(ee, 0, sizeof(ExecEnv));
+    ee->stack_size = stack_size;
+
+    if(stack_size == 0 && stack_cache_count != 0) {
+        pthread_mutex_lock(&stack_cache_lock);
+
+        if(stack_cache_count != 0) {
+            ee->stack = stack_cache[--stack_cache_count];
+            ee->stack_size = PAGE_ROUND(dflt_stack_size);
+            ee->stack_max = dfltMaxStackSize();
+        }
+
+        pthread_mutex_unlock(&stack_cache_lock);
+    }
+
+    return ee;
+}
+
+static void releaseJavaStack(ExecEnv *ee) {
+    if(ee->stack != NULL && ee->stack_size == PAGE_ROUND(dflt_stack_size)
+                         && ee->stack_max == dfltMaxStackSize()) {
+        pthread_mutex_lock(&stack_cache_lock);
+
+        if(stack_cache_count < STACK_CACHE_SIZE) {
+            stack_cache[stack_cache_count++] = ee->stack;
+            ee->stack = NULL;
+        }
+
+        pthread_mutex_unlock(&stack_cache_lock);
+    }
+
+    if(ee->stack != NULL) {
+        freeJavaStack(ee);
+        ee->stack = NULL;
+    }
+}
+
+/* Called by the GC when the Java-level thread object is no longer
+   reachable, to free the native thread structure and its ExecEnv */
+
+void gcPendingFreeThread(Thread *thread) {
+    if(thread != NULL) {
+        gcPendingFree(thread->ee);
+        gcPendingFree(thread);
+    }
 }
 
 Object *initJavaThread(Thread *thread, char is_daemon, char *name,
@@ -474,12 +716,11 @@ Object *initJavaThread(Thread *thread, char is_daemon, char *name,
     return jlthread;
 }
 
-void initThread(Thread *thread, char is_daemon, void *stack_base) {
+/* Initialise the thread's condvars and park lock.  This is done
+   by the creating thread, as the park lock and condvar are also
+   used in the start handshake (see signalThreadRunning) */
 
-    /* Create the thread stack and store the thread structure in
-       thread-specific memory */
-    initialiseJavaStack(thread->ee);
-    setThreadSelf(thread);
+static void initThreadSync(Thread *thread) {
 
     /* Initialise wait condvar (the condvar is per-thread,
        not per-monitor) */
@@ -490,6 +731,25 @@ void initThread(Thread *thread, char is_daemon, void *stack_base) {
     thread->park_state = PARK_RUNNING;
     pthread_cond_init(&thread->park_cv, NULL);
     pthread_mutex_init(&thread->park_lock, NULL);
+}
+
+static void destroyThreadSync(Thread *thread) {
+    pthread_cond_destroy(&thread->wait_cv);
+    pthread_cond_destroy(&thread->park_cv);
+    pthread_mutex_destroy(&thread->park_lock);
+}
+
+void initThread(Thread *thread, char is_daemon, void *stack_base) {
+
+    /* Create the thread stack and store the thread structure in
+       thread-specific memory */
+    initialiseJavaStack(thread->ee);
+
+    /* The thread can be sampled once it's set as the current thread */
+    if(cpu_profiling)
+        cpuProfileAttachThread(thread);
+
+    setThreadSelf(thread);
 
     /* Record the thread's stack base */
     thread->stack_base = stack_base;
@@ -532,25 +792,38 @@ void initThread(Thread *thread, char is_daemon, void *stack_base) {
     pthread_mutex_unlock(&lock);
 }
 
+/* The start handshake uses the new thread's park lock and condvar
+   rather than the global thread lock, so thread start doesn't contend
+   with other threads starting, exiting or being suspended.  The
+   thread isn't yet running Java code, so it can't be parked */
+
 void signalThreadRunning(Thread *thread) {
     disableSuspend(thread);
-    pthread_mutex_lock(&lock);
+    pthread_mutex_lock(&thread->park_lock);
 
     classlibSetThreadState(thread, RUNNING);
-    pthread_cond_broadcast(&cv);
+    pthread_cond_broadcast(&thread->park_cv);
 
-    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&thread->park_lock);
     enableSuspend(thread);
 }
 
+static void waitForThreadRunning(Thread *thread) {
+    pthread_mutex_lock(&thread->park_lock);
+
+    while(classlibGetThreadState(thread) == CREATING)
+        pthread_cond_wait(&thread->park_cv, &thread->park_lock);
+
+    pthread_mutex_unlock(&thread->park_lock);
+}
+
 Thread *attachThread(char *name, char is_daemon, void *stack_base,
                      Thread *thread, Object *group) {
 
     Object *java_thread;
 
     /* Create the ExecEnv for the thread */
-    ExecEnv *ee = sysMalloc(sizeof(ExecEnv));
-    memset(ee, 0, sizeof(ExecEnv));
+    ExecEnv *ee = allocExecEnv(0);
 
     thread->tid = pthread_self();
     thread->ee = ee;
@@ -647,6 +920,10 @@ void *detachThread(Thread *thread) {
        afterwards. */
     disableSuspend(thread);
 
+    /* Stop sampling the thread, and record its outstanding samples */
+    if(cpu_profiling)
+        cpuProfileDetachThread(thread);
+
     /* Grab global lock, and update thread structures protected by
        it (thread list, thread ID and number of daemon threads) */
     pthread_mutex_lock(&lock);
@@ -672,9 +949,9 @@ void *detachThread(Thread *thread) {
        thread structure as another thread may be concurrently accessing it.
        However, they must have a reference to the java level thread --
        therefore, it is safe to free during GC when the thread is determined
-       to be no longer reachable. */
-    sysFree(ee->stack);
-    sysFree(ee);
+       to be no longer reachable.  The ExecEnv is freed with it, so the
+       thread's state can still be read once it has exited */
+    releaseJavaStack(ee);
 
     /* If no more daemon threads notify the main thread (which
        may be waiting to exit VM).  Note, this is not protected
@@ -725,18 +1002,19 @@ void *threadStart(void *arg) {
 
 void createJavaThread(Object *jThread, long long stack_size) {
     Thread *self = threadSelf();
-    ExecEnv *ee = sysMalloc(sizeof(ExecEnv));
+    ExecEnv *ee = allocExecEnv(stack_size);
     Thread *thread = sysMalloc(sizeof(Thread));
 
-    memset(ee, 0, sizeof(ExecEnv));
     memset(thread, 0, sizeof(Thread));
+    initThreadSync(thread);
 
     thread->ee = ee;
     ee->thread = jThread;
-    ee->stack_size = stack_size;
 
     if(!classlibCreateJavaThread(thread, jThread)) {
+        destroyThreadSync(thread);
         sysFree(thread);
+        releaseJavaStack(ee);
         sysFree(ee);
         return;
     }
@@ -745,19 +1023,15 @@ void createJavaThread(Object *jThread, long long stack_size) {
 
     if(pthread_create(&thread->tid, &attributes, threadStart, thread)) {
         classlibMarkThreadTerminated(jThread);
-        sysFree(ee);
+        releaseJavaStack(ee);
         enableSuspend(self);
         signalException(java_lang_OutOfMemoryError, "can't create thread");
         return;
     }
 
-    pthread_mutex_lock(&lock);
-
     /* Wait for thread to start */
-    while(classlibGetThreadState(thread) == CREATING)
-        pthread_cond_wait(&cv, &lock);
+    waitForThreadRunning(thread);
 
-    pthread_mutex_unlock(&lock);
     enableSuspend(self);
 }
 
@@ -773,6 +1047,7 @@ Thread *attachJNIThread(char *name, char is_daemon, Object *group) {
 
     /* Initialise internal thread structure */
     memset(thread, 0, sizeof(Thread));
+    initThreadSync(thread);
 
     /* Externally created threads will not inherit signal state */
     initialiseSignalMask();
@@ -814,14 +1089,12 @@ void createVMThread(char *name, void (*start)(Thread*)) {
     args[2] = thread;
 
     memset(thread, 0, sizeof(Thread));
+    initThreadSync(thread);
+
     pthread_create(&tid, &attributes, shell, args);
 
     /* Wait for thread to start */
-
-    pthread_mutex_lock(&lock);
-    while(classlibGetThreadState(thread) == CREATING)
-        pthread_cond_wait(&cv, &lock);
-    pthread_mutex_unlock(&lock);
+    waitForThreadRunning(thread);
 }
 
 Object *runningThreadStackTrace(Thread *thread, int max_depth,
@@ -1132,6 +1405,9 @@ void printThreadsDump(Thread *self) {
         }
     }
     resumeAllThreads(self);
+
+    if(lock_profiling)
+        printLockProfile();
 }
 
 static void initialiseSignalMask() {
@@ -1177,6 +1453,19 @@ void scanThreads() {
     pthread_mutex_unlock(&lock);
 }
 
+#ifdef INLINING
+extern void scanThreadCodeRefs(Thread *thread);
+
+void scanThreadsCodeRefs() {
+    Thread *thread;
+
+    pthread_mutex_lock(&lock);
+    for(thread = &main_thread; thread != NULL; thread = thread->next)
+        scanThreadCodeRefs(thread);
+    pthread_mutex_unlock(&lock);
+}
+#endif
+
 int systemIdle(Thread *self) {
     Thread *thread;
 
@@ -1278,6 +1567,14 @@ int initialiseThreadStage1(InitArgs *args) {
 
     /* Set the default size of the Java stack for each _new_ thread */
     dflt_stack_size = args->java_stack;
+    dflt_max_stack_size = args->max_java_stack;
+    page_size = getpagesize();
+#ifdef IMPLICIT_STACK_CHECKS
+    guard_size = PAGE_ROUND(2 * 65536 * sizeof(uintptr_t) +
+                            sizeof(Frame) + 16);
+#else
+    guard_size = page_size;
+#endif
 
     /* Initialise internal locks and pthread state */
     pthread_mutex_init(&lock, NULL);
@@ -1315,11 +1612,7 @@ int initialiseThreadStage1(InitArgs *args) {
     initialiseJavaStack(&main_ee);
     setThreadSelf(&main_thread);
 
-    pthread_cond_init(&main_thread.wait_cv, NULL);
-
-    main_thread.park_state = PARK_RUNNING;
-    pthread_cond_init(&main_thread.park_cv, NULL);
-    pthread_mutex_init(&main_thread.park_lock, NULL);
+    initThreadSync(&main_thread);
 
     return TRUE;
 }
@@ -88,6 +88,9 @@ typedef struct monitor {
     uintptr_t entering;
     int wait_count;
     Thread *wait_set;
+    pthread_mutex_t flc_lock;
+    pthread_cond_t flc_cv;
+    volatile unsigned int flc_seq;
     struct monitor *next;
 } Monitor;
 
@@ -106,6 +109,10 @@ struct thread {
     pthread_mutex_t park_lock;
     long long blocked_count;
     long long waited_count;
+    long long blocked_time;
+    long long waited_time;
+    unsigned int lock_prof_tick;
+    struct prof_buffer *prof_buffer;
     Thread *prev, *next;
     unsigned int wait_id;
     unsigned int notify_id;
@@ -120,6 +127,7 @@ struct thread {
 extern Thread *threadSelf();
 extern long long javaThreadId(Thread *thread);
 extern Thread *jThread2Thread(Object *jThread);
+extern void gcPendingFreeThread(Thread *thread);
 extern long long jThread2ThreadId(Object *jthread);
 
 extern void *getStackTop(Thread *thread);
@@ -165,6 +173,10 @@ extern Object *runningThreadStackTrace(Thread *thread, int max_depth,
 extern Object *runningThreadObjects();
 extern void printThreadsDump(Thread *self);
 
+extern int cpu_profiling;
+extern void cpuProfileAttachThread(Thread *thread);
+extern void cpuProfileDetachThread(Thread *thread);
+
 #define disableSuspend(thread)             \
 {                                          \
     sigjmp_buf *env;                       \
@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2014 Robert Lougher <rob@jamvm.org.uk>.
+ *
+ * This file is part of JamVM.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Generates the static superinstructions used by the direct-threaded
+   interpreter (src/interp/engine/superinsns.h) from an opcode-sequence
+   profile.
+
+   Each line of the profile is an execution count, followed by an
+   optional percentage, and a sequence of opcode names, e.g.
+
+        1234567  2.31%  iload_1 iload_2 iadd
+
+   The "Opcode pairs" section printed by -Xopcodestats (in a build
+   configured with --enable-opcode-stats) can be used directly, and
+   longer sequences can be added by hand.  Lines with a single opcode,
+   or with an opcode which can't be part of a superinstruction, are
+   ignored.
+
+   Only simple opcodes which can't throw an exception, branch or be
+   rewritten at runtime can be combined.  The most frequent sequences
+   are chosen, up to the number of free opcodes (OPC_SUPER_0, etc.) */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#define MAX_SUPER_INSNS 10
+#define MAX_SEQUENCE_LEN 4
+
+/* How an opcode changes the depth of the operand stack cache,
+   following the rules used by prepare in direct.c */
+#define PUSH   0
+#define POP    1
+#define UNARY  2
+#define BINARY 3
+#define NONE   4
+
+typedef struct {
+    char *name;
+    char *handler;
+    int effect;
+    char *body;
+} OpcodeBody;
+
+/* The body of each opcode, operating on the operand stack (with
+   stack-caching, the cache is flushed before the bodies and refilled
+   after them).  Opcodes which share a handler in interp.c give the
+   same handler opcode (prepare matches instructions by handler) */
+
+static OpcodeBody bodies[] = {
+    {"aconst_null",      "OPC_ICONST_0",       PUSH,   "*ostack++ = 0;"},
+    {"iconst_m1",        "OPC_ICONST_M1",      PUSH,   "*ostack++ = -1;"},
+    {"iconst_0",         "OPC_ICONST_0",       PUSH,   "*ostack++ = 0;"},
+    {"iconst_1",         "OPC_ICONST_1",       PUSH,   "*ostack++ = 1;"},
+    {"iconst_2",         "OPC_ICONST_2",       PUSH,   "*ostack++ = 2;"},
+    {"iconst_3",         "OPC_ICONST_3",       PUSH,   "*ostack++ = 3;"},
+    {"iconst_4",         "OPC_ICONST_4",       PUSH,   "*ostack++ = 4;"},
+    {"iconst_5",         "OPC_ICONST_5",       PUSH,   "*ostack++ = 5;"},
+    {"fconst_0",         "OPC_ICONST_0",       PUSH,   "*ostack++ = 0;"},
+    {"fconst_1",         "OPC_FCONST_1",       PUSH,
+                        "*ostack++ = FLOAT_1_BITS;"},
+    {"fconst_2",         "OPC_FCONST_2",       PUSH,
+                        "*ostack++ = FLOAT_2_BITS;"},
+    {"bipush",           "OPC_BIPUSH",         PUSH,
+                        "*ostack++ = SINGLE_SIGNED(pc);"},
+    {"sipush",           "OPC_SIPUSH",         PUSH,
+                        "*ostack++ = DOUBLE_SIGNED(pc);"},
+    {"iload",            "OPC_ILOAD",          PUSH,
+                        "*ostack++ = lvars[SINGLE_INDEX(pc)];"},
+    {"fload",            "OPC_ILOAD",          PUSH,
+                        "*ostack++ = lvars[SINGLE_INDEX(pc)];"},
+    {"aload",            "OPC_ILOAD",          PUSH,
+                        "*ostack++ = lvars[SINGLE_INDEX(pc)];"},
+    {"iload_0",          "OPC_ILOAD_0",        PUSH,   "*ostack++ = lvars[0];"},
+    {"fload_0",          "OPC_ILOAD_0",        PUSH,   "*ostack++ = lvars[0];"},
+    /* An aload_0 which isn't combined with a following
+       getfield is prepared as iload_0 */
+    {"aload_0",          "OPC_ILOAD_0",        PUSH,   "*ostack++ = lvars[0];"},
+    {"iload_1",          "OPC_ILOAD_1",        PUSH,   "*ostack++ = lvars[1];"},
+    {"fload_1",          "OPC_ILOAD_1",        PUSH,   "*ostack++ = lvars[1];"},
+    {"aload_1",          "OPC_ILOAD_1",        PUSH,   "*ostack++ = lvars[1];"},
+    {"iload_2",          "OPC_ILOAD_2",        PUSH,   "*ostack++ = lvars[2];"},
+    {"fload_2",          "OPC_ILOAD_2",        PUSH,   "*ostack++ = lvars[2];"},
+    {"aload_2",          "OPC_ILOAD_2",        PUSH,   "*ostack++ = lvars[2];"},
+    {"iload_3",          "OPC_ILOAD_3",        PUSH,   "*ostack++ = lvars[3];"},
+    {"fload_3",          "OPC_ILOAD_3",        PUSH,   "*ostack++ = lvars[3];"},
+    {"aload_3",          "OPC_ILOAD_3",        PUSH,   "*ostack++ = lvars[3];"},
+    {"getfield_this",    "OPC_GETFIELD_THIS",  PUSH,
+                        "*ostack++ = INST_DATA(this, u4, GETFIELD_THIS_OFFSET(pc));"},
+    {"getfield_this_ref","OPC_GETFIELD_THIS_REF",PUSH,
+                        "*ostack++ = INST_DATA(this, uintptr_t, GETFIELD_THIS_OFFSET(pc));"},
+    {"istore",           "OPC_ISTORE",         POP,
+                        "lvars[SINGLE_INDEX(pc)] = *--ostack;"},
+    {"fstore",           "OPC_ISTORE",         POP,
+                        "lvars[SINGLE_INDEX(pc)] = *--ostack;"},
+    {"astore",           "OPC_ISTORE",         POP,
+                        "lvars[SINGLE_INDEX(pc)] = *--ostack;"},
+    {"istore_0",         "OPC_ISTORE_0",       POP,    "lvars[0] = *--ostack;"},
+    {"fstore_0",         "OPC_ISTORE_0",       POP,    "lvars[0] = *--ostack;"},
+    {"astore_0",         "OPC_ISTORE_0",       POP,    "lvars[0] = *--ostack;"},
+    {"istore_1",         "OPC_ISTORE_1",       POP,    "lvars[1] = *--ostack;"},
+    {"fstore_1",         "OPC_ISTORE_1",       POP,    "lvars[1] = *--ostack;"},
+    {"astore_1",         "OPC_ISTORE_1",       POP,    "lvars[1] = *--ostack;"},
+    {"istore_2",         "OPC_ISTORE_2",       POP,    "lvars[2] = *--ostack;"},
+    {"fstore_2",         "OPC_ISTORE_2",       POP,    "lvars[2] = *--ostack;"},
+    {"astore_2",         "OPC_ISTORE_2",       POP,    "lvars[2] = *--ostack;"},
+    {"istore_3",         "OPC_ISTORE_3",       POP,    "lvars[3] = *--ostack;"},
+    {"fstore_3",         "OPC_ISTORE_3",       POP,    "lvars[3] = *--ostack;"},
+    {"astore_3",         "OPC_ISTORE_3",       POP,    "lvars[3] = *--ostack;"},
+    {"iadd",             "OPC_IADD",           BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] + (int)ostack[0];"},
+    {"isub",             "OPC_ISUB",           BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] - (int)ostack[0];"},
+    {"imul",             "OPC_IMUL",           BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] * (int)ostack[0];"},
+    {"iand",             "OPC_IAND",           BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] & (int)ostack[0];"},
+    {"ior",              "OPC_IOR",            BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] | (int)ostack[0];"},
+    {"ixor",             "OPC_IXOR",           BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] ^ (int)ostack[0];"},
+    {"ishl",             "OPC_ISHL",           BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] << (ostack[0] & 0x1f);"},
+    {"ishr",             "OPC_ISHR",           BINARY,
+                        "ostack--; ostack[-1] = (int)ostack[-1] >> (ostack[0] & 0x1f);"},
+    {"iushr",            "OPC_IUSHR",          BINARY,
+                        "ostack--; ostack[-1] = (unsigned int)ostack[-1] >> (ostack[0] & 0x1f);"},
+    {"ineg",             "OPC_INEG",           UNARY,
+                        "ostack[-1] = -(int)ostack[-1];"},
+    {"iinc",             "OPC_IINC",           NONE,
+                        "lvars[IINC_LVAR_IDX(pc)] += IINC_DELTA(pc);"},
+    {"pop",              "OPC_POP",            POP,    "ostack--;"},
+    {"dup",              "OPC_DUP",            PUSH,
+                        "*ostack = ostack[-1]; ostack++;"},
+    {NULL,              NULL,                 0,      NULL}
+};
+
+typedef struct {
+    OpcodeBody *sequence[MAX_SEQUENCE_LEN];
+    int length;
+    unsigned long long count;
+} Sequence;
+
+Sequence *sequences = NULL;
+int sequences_count = 0;
+int sequences_size = 0;
+
+void *sysRealloc(void *addr, int size) {
+    void *mem = realloc(addr, size);
+
+    if(mem == NULL) {
+        perror("Realloc failed\n");
+        exit(1);
+    }
+
+    return mem;
+}
+
+OpcodeBody *findOpcode(char *name) {
+    int i;
+
+    for(i = 0; bodies[i].name != NULL; i++)
+        if(strcmp(bodies[i].name, name) == 0)
+            return &bodies[i];
+
+    return NULL;
+}
+
+/* Sequences which differ only in opcodes sharing a handler
+   are the same superinstruction, so their counts are merged */
+
+void addSequence(OpcodeBody **sequence, int length,
+                 unsigned long long count) {
+    int i, j;
+
+    for(i = 0; i < sequences_count; i++) {
+        if(sequences[i].length != length)
+            continue;
+
+        for(j = 0; j < length && strcmp(sequences[i].sequence[j]->handler,
+                                        sequence[j]->handler) == 0; j++);
+
+        if(j == length) {
+            sequences[i].count += count;
+            return;
+        }
+    }
+
+    if(sequences_count == sequences_size) {
+        sequences_size += 64;
+        sequences = sysRealloc(sequences, sequences_size * sizeof(Sequence));
+    }
+
+    memcpy(sequences[i].sequence, sequence, length * sizeof(OpcodeBody*));
+    sequences[i].length = length;
+    sequences[i].count = count;
+    sequences_count++;
+}
+
+void parseLine(char *line) {
+    OpcodeBody *sequence[MAX_SEQUENCE_LEN];
+    unsigned long long count;
+    int length = 0;
+    char *token;
+
+    if((token = strtok(line, " \t\n")) == NULL || *token == '#'
+                                               || !isdigit(*token))
+        return;
+
+    count = strtoull(token, NULL, 10);
+
+    while((token = strtok(NULL, " \t\n")) != NULL) {
+        /* Skip the percentage */
+        if(length == 0 && isdigit(*token))
+            continue;
+
+        if(length == MAX_SEQUENCE_LEN ||
+                    (sequence[length++] = findOpcode(token)) == NULL)
+            return;
+    }
+
+    if(length > 1)
+        addSequence(sequence, length, count);
+}
+
+void readProfile(char *filename) {
+    FILE *fd = fopen(filename, "r");
+    char buff[1024];
+
+    if(fd == NULL) {
+        perror("Couldn't open profile file for reading");
+        exit(1);
+    }
+
+    while(fgets(buff, sizeof(buff), fd) != NULL)
+        parseLine(buff);
+
+    fclose(fd);
+}
+
+int compareCounts(const void *p1, const void *p2) {
+    unsigned long long count1 = ((Sequence*)p1)->count;
+    unsigned long long count2 = ((Sequence*)p2)->count;
+
+    return count1 < count2 ? 1 : count1 > count2 ? -1 : 0;
+}
+
+/* The depth of the operand stack cache after a sequence, given
+   the depth before it.  Prepare only selects a superinstruction
+   where this is the depth of the following instruction */
+
+int exitDepth(Sequence *sequence, int depth) {
+    int i;
+
+    for(i = 0; i < sequence->length; i++)
+        switch(sequence->sequence[i]->effect) {
+            case PUSH:
+                if(depth < 2)
+                    depth++;
+                break;
+
+            case POP:
+                if(depth > 0)
+                    depth--;
+                break;
+
+            case UNARY:
+                depth = depth == 2 ? 2 : 1;
+                break;
+
+            case BINARY:
+                depth = 1;
+                break;
+        }
+
+    return depth;
+}
+
+/* Prepare uses the first sequence which matches, so
+   longer sequences must come first */
+int compareLengths(const void *p1, const void *p2) {
+    int length1 = ((Sequence*)p1)->length;
+    int length2 = ((Sequence*)p2)->length;
+
+    if(length1 != length2)
+        return length2 - length1;
+
+    return compareCounts(p1, p2);
+}
+
+void writeMacroLine(FILE *fd, char *fmt, char *arg1, char *arg2) {
+    char buff[256];
+
+    snprintf(buff, sizeof(buff), fmt, arg1, arg2);
+    fprintf(fd, "%-58s \\\n", buff);
+}
+
+void writeHeader(char *header_name, char *profile_name) {
+    FILE *fd = fopen(header_name, "w");
+    int i, j;
+
+    if(fd == NULL) {
+        perror("Couldn't open header file for writing");
+        exit(1);
+    }
+
+    fprintf(fd, "/* Generated by gen-superinsns.c from profile file %s */\n\n",
+                profile_name);
+
+    fprintf(fd, "#define SUPER_INSNS_COUNT %d\n", sequences_count);
+    fprintf(fd, "#define SUPER_INSN_MAX_LEN %d\n\n", MAX_SEQUENCE_LEN);
+
+    for(i = 0; i < sequences_count; i++) {
+        fprintf(fd, "/* OPC_SUPER_%d:", i);
+        for(j = 0; j < sequences[i].length; j++)
+            fprintf(fd, " %s", sequences[i].sequence[j]->name);
+        fprintf(fd, " (%llu) */\n", sequences[i].count);
+    }
+
+    fprintf(fd, "\n");
+    writeMacroLine(fd, "#define SUPER_INSN_PATTERNS", NULL, NULL);
+
+    for(i = 0; i < sequences_count; i++) {
+        char opcode[24], pattern[128];
+
+        sprintf(opcode, "OPC_SUPER_%d", i);
+        sprintf(pattern, "%d, {%d, %d, %d}, {", sequences[i].length,
+                exitDepth(&sequences[i], 0), exitDepth(&sequences[i], 1),
+                exitDepth(&sequences[i], 2));
+
+        for(j = 0; j < sequences[i].length; j++)
+            sprintf(pattern + strlen(pattern), "%s%s", j ? ", " : "",
+                    sequences[i].sequence[j]->handler);
+
+        writeMacroLine(fd, "    {%s, %s}},", opcode, pattern);
+    }
+
+    fprintf(fd, "    {-1, 0, {0}, {0}}\n\n");
+
+    /* A superinstruction executes each body in turn.  The pc is
+       incremented between them, so each body sees its own operand.
+       DEF_SUPER_OPC (see interp-direct.h) is given the cache depth
+       after the sequence for each depth before it, and dispatches
+       the next instruction.  The free opcodes which aren't used are
+       given a dummy handler */
+
+    writeMacroLine(fd, "#define SUPER_INSN_HANDLERS", NULL, NULL);
+
+    for(i = 0; i < MAX_SUPER_INSNS; i++) {
+        char opcode[24], depths[16];
+
+        sprintf(opcode, "OPC_SUPER_%d", i);
+
+        if(i >= sequences_count) {
+            writeMacroLine(fd, "    DEF_SUPER_OPC(%s, 0, 0, 0,", opcode, NULL);
+            writeMacroLine(fd, "        goto unused;", NULL, NULL);
+        } else {
+            sprintf(depths, "%d, %d, %d", exitDepth(&sequences[i], 0),
+                    exitDepth(&sequences[i], 1), exitDepth(&sequences[i], 2));
+            writeMacroLine(fd, "    DEF_SUPER_OPC(%s, %s,", opcode, depths);
+
+            for(j = 0; j < sequences[i].length; j++) {
+                if(j > 0)
+                    writeMacroLine(fd, "        pc++;", NULL, NULL);
+                writeMacroLine(fd, "        %s", sequences[i].sequence[j]->body,
+                               NULL);
+            }
+
+            writeMacroLine(fd, "        pc++;", NULL, NULL);
+        }
+
+        writeMacroLine(fd, "    )", NULL, NULL);
+        writeMacroLine(fd, "", NULL, NULL);
+    }
+
+    fprintf(fd, "\n");
+    fclose(fd);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc != 3) {
+        printf("Usage: %s <input profile file> <output header file>\n",
+               argv[0]);
+        return 1;
+    }
+
+    readProfile(argv[1]);
+
+    qsort(sequences, sequences_count, sizeof(Sequence), compareCounts);
+
+    if(sequences_count > MAX_SUPER_INSNS)
+        sequences_count = MAX_SUPER_INSNS;
+
+    qsort(sequences, sequences_count, sizeof(Sequence), compareLengths);
+
+    writeHeader(argv[2], argv[1]);
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+# Default sequences for gen-superinsns.  These are sequences common in
+# javac output (local variable loads, increments and simple integer
+# expressions).  The counts only rank the sequences.  To tune for a
+# workload, use the "Opcode pairs" printed by -Xopcodestats instead.
+#
+# count  sequence
+
+    9000  iload iload
+    8500  iload_1 iload_2
+    8000  iinc iload
+    7500  iload iconst_1 iadd
+    7000  iload iload iadd
+    6500  istore iload
+    6000  aload_0 iload_1
+    5500  iload_2 iload_3
+    5000  getfield_this getfield_this
+    4500  iconst_0 istore